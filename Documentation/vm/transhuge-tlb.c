@@ -0,0 +1,99 @@
+/*
+ * TLB miss benchmark for transparent hugepages.
+ *
+ * Maps an anonymous region aligned to the huge page size, faults it in
+ * with either MADV_HUGEPAGE or MADV_NOHUGEPAGE and then touches one
+ * word per small page in a pseudo-random order, so that nearly every
+ * access misses the TLB when the region is mapped with small pages.
+ * The same run is repeated for both modes and the time per access is
+ * printed.  Compare the AnonHugePages line of /proc/meminfo while it
+ * runs to see whether hugepages were actually used.
+ *
+ * Usage: transhuge-tlb [size in MB] [rounds]
+ *
+ * It has no other dependency than libc, so it can be run on emulated
+ * targets such as QEMU too, although the absolute numbers are then
+ * only meaningful relative to each other.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE	14
+#endif
+#ifndef MADV_NOHUGEPAGE
+#define MADV_NOHUGEPAGE	15
+#endif
+
+#define HPAGE_SIZE	(2UL * 1024 * 1024)
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double run(unsigned long length, int rounds, int advice)
+{
+	unsigned long pagesize = getpagesize();
+	unsigned long npages = length / pagesize;
+	unsigned long i, idx, sum = 0;
+	char *raw, *addr;
+	double start, elapsed;
+	int r;
+
+	raw = mmap(NULL, length + HPAGE_SIZE, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	addr = (char *)(((uintptr_t)raw + HPAGE_SIZE - 1) & ~(HPAGE_SIZE - 1));
+
+	if (madvise(addr, length, advice))
+		perror("madvise");
+
+	for (i = 0; i < length; i += pagesize)
+		addr[i] = 1;
+
+	/* npages is a power of two: an odd stride visits every page once */
+	start = now();
+	for (r = 0; r < rounds; r++) {
+		idx = r;
+		for (i = 0; i < npages; i++) {
+			idx = (idx + 4099) & (npages - 1);
+			sum += addr[idx * pagesize];
+		}
+	}
+	elapsed = now() - start;
+
+	munmap(raw, length + HPAGE_SIZE);
+	if (sum == 0)
+		printf("\n");
+	return elapsed * 1e9 / ((double)npages * rounds);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long mb = argc > 1 ? strtoul(argv[1], NULL, 0) : 64;
+	int rounds = argc > 2 ? atoi(argv[2]) : 16;
+	unsigned long length;
+
+	/* round down to a power of two for the access pattern */
+	for (length = HPAGE_SIZE; length * 2 <= mb << 20; length *= 2)
+		;
+
+	printf("%lu MB, %d rounds\n", length >> 20, rounds);
+	printf("small pages: %.2f ns/access\n",
+	       run(length, rounds, MADV_NOHUGEPAGE));
+	printf("huge pages:  %.2f ns/access\n",
+	       run(length, rounds, MADV_HUGEPAGE));
+
+	return 0;
+}
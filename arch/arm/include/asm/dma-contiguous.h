@@ -0,0 +1,12 @@
+#ifndef ASMARM_DMA_CONTIGUOUS_H
+#define ASMARM_DMA_CONTIGUOUS_H
+
+#ifdef __KERNEL__
+#ifdef CONFIG_CMA
+
+#include <asm-generic/dma-contiguous.h>
+
+#endif
+#endif
+
+#endif
@@ -53,6 +53,13 @@
 
 #define domain_val(dom,type)	((type) << (2*(dom)))
 
+/*
+ * Transparent huge pages are mapped with user sections that keep
+ * software state in the upper bits of their domain field (see
+ * pgtable.h).  Those domains must behave exactly like DOMAIN_USER.
+ */
+#define DOMAIN_USER_HUGE(x)	(DOMAIN_USER | ((x) << 1))
+
 #ifndef __ASSEMBLY__
 
 #ifdef CONFIG_CPU_USE_DOMAINS
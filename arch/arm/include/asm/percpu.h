@@ -1,6 +1,54 @@
 #ifndef __ARM_PERCPU
 #define __ARM_PERCPU
 
+#include <linux/types.h>
 #include <asm-generic/percpu.h>
 
+#ifndef CONFIG_GENERIC_ATOMIC64
+/*
+ * Double word compare and exchange of two adjacent per cpu words, as
+ * used by the SLUB fastpath.  The generic version disables interrupts;
+ * ldrexd/strexd is atomic against both interrupts and other cpus, so
+ * it does not matter if we are preempted and migrate between computing
+ * the per cpu address and the exchange.  The caller makes sure (by
+ * means of a transaction id in the second word) that this then fails.
+ *
+ * The words are compared and stored in memory order, which keeps this
+ * independent of endianness.
+ */
+static inline int __percpu_cmpxchg_double(void *ptr,
+					  unsigned long o1, unsigned long o2,
+					  unsigned long n1, unsigned long n2)
+{
+	union {
+		u64 d;
+		unsigned long w[2];
+	} old, new = { .w = { n1, n2 } };
+	unsigned long res;
+
+	do {
+		__asm__ __volatile__("@ percpu_cmpxchg_double\n"
+		"ldrexd		%1, %H1, [%3]\n"
+		"mov		%0, #0\n"
+		"teq		%1, %4\n"
+		"teqeq		%H1, %5\n"
+		"strexdeq	%0, %6, %H6, [%3]"
+		: "=&r" (res), "=&r" (old.d), "+Qo" (*(u64 *)ptr)
+		: "r" (ptr), "r" (o1), "r" (o2), "r" (new.d)
+		: "cc");
+	} while (res);
+
+	return old.w[0] == o1 && old.w[1] == o2;
+}
+
+#define percpu_cmpxchg_double(pcp1, o1, o2, n1, n2)			\
+	__percpu_cmpxchg_double(__this_cpu_ptr(&(pcp1)),		\
+				(unsigned long)(o1), (unsigned long)(o2), \
+				(unsigned long)(n1), (unsigned long)(n2))
+
+#define __this_cpu_cmpxchg_double_4(pcp1, pcp2, o1, o2, n1, n2)		percpu_cmpxchg_double(pcp1, o1, o2, n1, n2)
+#define this_cpu_cmpxchg_double_4(pcp1, pcp2, o1, o2, n1, n2)		percpu_cmpxchg_double(pcp1, o1, o2, n1, n2)
+#define irqsafe_cpu_cmpxchg_double_4(pcp1, pcp2, o1, o2, n1, n2)	percpu_cmpxchg_double(pcp1, o1, o2, n1, n2)
+#endif /* CONFIG_GENERIC_ATOMIC64 */
+
 #endif
@@ -22,6 +22,7 @@
 
 #include <asm/memory.h>
 #include <mach/vmalloc.h>
+#include <asm/domain.h>
 #include <asm/pgtable-hwdef.h>
 
 /*
@@ -309,7 +310,12 @@ extern pgd_t swapper_pg_dir[PTRS_PER_PGD];
 
 #define pmd_none(pmd)		(!pmd_val(pmd))
 #define pmd_present(pmd)	(pmd_val(pmd))
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/* a section mapping a transparent huge page is not a bad pmd */
+#define pmd_bad(pmd)		((pmd_val(pmd) & 2) && !pmd_trans_huge(pmd))
+#else
 #define pmd_bad(pmd)		(pmd_val(pmd) & 2)
+#endif
 
 #define copy_pmd(pmdpd,pmdps)		\
 	do {				\
@@ -330,7 +336,13 @@ static inline pte_t *pmd_page_vaddr(pmd_t pmd)
 	return __va(pmd_val(pmd) & PAGE_MASK);
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#define pmd_pfn(pmd)		__phys_to_pfn(pmd_val(pmd) & \
+				(pmd_trans_huge(pmd) ? SECTION_MASK : PAGE_MASK))
+#define pmd_page(pmd)		pfn_to_page(pmd_pfn(pmd))
+#else
 #define pmd_page(pmd)		pfn_to_page(__phys_to_pfn(pmd_val(pmd)))
+#endif
 
 /* we don't need complex calculations here as the pmd is folded into the pgd */
 #define pmd_addr_end(addr,end)	(end)
@@ -456,6 +468,105 @@ static inline pte_t pte_modify(pte_t pte, pgprot_t newprot)
 
 #define PTE_FILE_MAX_BITS	29
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+/*
+ * Transparent huge pages are mapped by a pair of 1MB user sections, so
+ * a huge pmd covers the same 2MB as a Linux pmd.  Sections have no
+ * "Linux" copy to keep state in, so it is encoded in the section itself:
+ *
+ *  - AP[0] is always set, APX is the write protection.
+ *  - "young" is AP[1] (user access), emulated like for PTEs: an old
+ *    section faults on user access and huge_pmd_set_accessed() makes
+ *    it young again.
+ *  - PMD_SECT_PROT_USER remembers whether the mapping may be made
+ *    young at all, i.e. whether it is not PROT_NONE.
+ *  - PMD_SECT_SPLITTING is the split_huge_page() marker.
+ *
+ * The two software bits live in the domain field, so DOMAIN_USER_HUGE()
+ * domains are set up as clients (see head.S).  There is no dirty
+ * tracking: anonymous huge pages are always dirty.
+ */
+#define PMD_SECT_YOUNG		PMD_SECT_AP_READ
+#define PMD_SECT_SPLITTING	PMD_DOMAIN(DOMAIN_USER_HUGE(1) ^ DOMAIN_USER)
+#define PMD_SECT_PROT_USER	PMD_DOMAIN(DOMAIN_USER_HUGE(2) ^ DOMAIN_USER)
+
+/* cache attributes, domain and nG bits of user sections */
+extern unsigned long pmd_user_sect_prot;
+
+struct vm_area_struct;
+
+static inline int pmd_trans_huge(pmd_t pmd)
+{
+	return (pmd_val(pmd) & PMD_TYPE_MASK) == PMD_TYPE_SECT;
+}
+
+static inline int pmd_trans_splitting(pmd_t pmd)
+{
+	return pmd_val(pmd) & PMD_SECT_SPLITTING;
+}
+
+static inline int has_transparent_hugepage(void)
+{
+	return 1;
+}
+
+#define pmd_write(pmd)		(!(pmd_val(pmd) & PMD_SECT_APX))
+#define pmd_young(pmd)		(pmd_val(pmd) & PMD_SECT_YOUNG)
+
+#define PMD_BIT_FUNC(fn,op) \
+static inline pmd_t pmd_##fn(pmd_t pmd) { pmd_val(pmd) op; return pmd; }
+
+PMD_BIT_FUNC(wrprotect,	|= PMD_SECT_APX);
+PMD_BIT_FUNC(mkwrite,	&= ~PMD_SECT_APX);
+PMD_BIT_FUNC(mkold,	&= ~PMD_SECT_YOUNG);
+PMD_BIT_FUNC(mknotpresent, &= ~PMD_SECT_YOUNG);
+PMD_BIT_FUNC(mksplitting, |= PMD_SECT_SPLITTING);
+
+#define pmd_mkdirty(pmd)	(pmd)
+#define pmd_mkhuge(pmd)		(pmd)
+
+static inline pmd_t pmd_mkyoung(pmd_t pmd)
+{
+	if (pmd_val(pmd) & PMD_SECT_PROT_USER)
+		pmd_val(pmd) |= PMD_SECT_YOUNG;
+	return pmd;
+}
+
+static inline pmd_t pmd_modify(pmd_t pmd, pgprot_t newprot)
+{
+	pteval_t prot = pgprot_val(newprot);
+
+	pmd_val(pmd) &= ~(PMD_SECT_YOUNG | PMD_SECT_PROT_USER |
+			  PMD_SECT_APX | PMD_SECT_XN);
+	if (prot & L_PTE_USER)
+		pmd_val(pmd) |= PMD_SECT_PROT_USER | PMD_SECT_YOUNG;
+	if (prot & L_PTE_RDONLY)
+		pmd_val(pmd) |= PMD_SECT_APX;
+	if (prot & L_PTE_XN)
+		pmd_val(pmd) |= PMD_SECT_XN;
+	return pmd;
+}
+
+#define pfn_pmd(pfn,prot)	pmd_modify(__pmd(__pfn_to_phys(pfn) | \
+				pmd_user_sect_prot | PMD_SECT_AP_WRITE), prot)
+#define mk_pmd(page,prot)	pfn_pmd(page_to_pfn(page), prot)
+
+extern void set_pmd_at(struct mm_struct *mm, unsigned long addr,
+		       pmd_t *pmdp, pmd_t pmd);
+
+#define __HAVE_ARCH_PMDP_GET_AND_CLEAR
+extern pmd_t pmdp_get_and_clear(struct mm_struct *mm, unsigned long addr,
+				pmd_t *pmdp);
+
+#define __HAVE_ARCH_PMDP_SPLITTING_FLUSH
+extern void pmdp_splitting_flush(struct vm_area_struct *vma,
+				 unsigned long addr, pmd_t *pmdp);
+
+#define flush_pmd_tlb_range flush_pmd_tlb_range
+extern void flush_pmd_tlb_range(struct vm_area_struct *vma,
+				unsigned long start, unsigned long end);
+#endif /* CONFIG_TRANSPARENT_HUGEPAGE */
+
 /* Needs to be defined here and not in linux/mm.h, as it is arch dependent */
 /* FIXME: this is not correct */
 #define kern_addr_valid(addr)	(1)
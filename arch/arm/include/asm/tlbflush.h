@@ -580,6 +580,9 @@ static inline void update_mmu_cache(struct vm_area_struct *vma,
 }
 #endif
 
+/* Huge pages are made coherent by set_pmd_at() */
+#define update_mmu_cache_pmd(vma, address, pmd) do { } while (0)
+
 #endif
 
 #endif /* CONFIG_MMU */
@@ -17,6 +17,7 @@
 #include <linux/init.h>
 #include <linux/device.h>
 #include <linux/dma-mapping.h>
+#include <linux/dma-contiguous.h>
 #include <linux/highmem.h>
 
 #include <asm/memory.h>
@@ -52,6 +53,25 @@ static u64 get_coherent_dma_mask(struct device *dev)
 	return mask;
 }
 
+/*
+ * Take a buffer from the contiguous memory area of 'dev', if it has
+ * one and the buffer suits the DMA mask.
+ */
+static struct page *__dma_alloc_from_contiguous(struct device *dev,
+		size_t size, unsigned long order, u64 mask)
+{
+	int count = size >> PAGE_SHIFT;
+	struct page *page;
+
+	page = dma_alloc_from_contiguous(dev, count, order);
+	if (page &&
+	    (u64)pfn_to_dma(dev, page_to_pfn(page)) + size - 1 > mask) {
+		dma_release_from_contiguous(dev, page, count);
+		page = NULL;
+	}
+	return page;
+}
+
 /*
  * Allocate a DMA buffer for 'dev' of size 'size' using the
  * specified gfp mask.  Note that 'size' must be page aligned.
@@ -59,7 +79,7 @@ static u64 get_coherent_dma_mask(struct device *dev)
 static struct page *__dma_alloc_buffer(struct device *dev, size_t size, gfp_t gfp)
 {
 	unsigned long order = get_order(size);
-	struct page *page, *p, *e;
+	struct page *page = NULL, *p, *e;
 	void *ptr;
 	u64 mask = get_coherent_dma_mask(dev);
 
@@ -78,16 +98,26 @@ static struct page *__dma_alloc_buffer(struct device *dev, size_t size, gfp_t gf
 	if (mask < 0xffffffffULL)
 		gfp |= GFP_DMA;
 
-	page = alloc_pages(gfp, order);
-	if (!page)
-		return NULL;
-
 	/*
-	 * Now split the huge page and free the excess pages
+	 * Multi-page buffers for callers which may sleep come from the
+	 * contiguous memory area, so that they need no free high order
+	 * page.
 	 */
-	split_page(page, order);
-	for (p = page + (size >> PAGE_SHIFT), e = page + (1 << order); p < e; p++)
-		__free_page(p);
+	if (size > PAGE_SIZE && (gfp & __GFP_WAIT))
+		page = __dma_alloc_from_contiguous(dev, size, order, mask);
+
+	if (!page) {
+		page = alloc_pages(gfp, order);
+		if (!page)
+			return NULL;
+
+		/*
+		 * Now split the huge page and free the excess pages
+		 */
+		split_page(page, order);
+		for (p = page + (size >> PAGE_SHIFT), e = page + (1 << order); p < e; p++)
+			__free_page(p);
+	}
 
 	/*
 	 * Ensure that the allocated pages are zeroed, and that any data
@@ -104,10 +134,13 @@ static struct page *__dma_alloc_buffer(struct device *dev, size_t size, gfp_t gf
 /*
  * Free a DMA buffer.  'size' must be page aligned.
  */
-static void __dma_free_buffer(struct page *page, size_t size)
+static void __dma_free_buffer(struct device *dev, struct page *page, size_t size)
 {
 	struct page *e = page + (size >> PAGE_SHIFT);
 
+	if (dma_release_from_contiguous(dev, page, size >> PAGE_SHIFT))
+		return;
+
 	while (page < e) {
 		__free_page(page);
 		page++;
@@ -323,7 +356,7 @@ __dma_alloc(struct device *dev, size_t size, dma_addr_t *handle, gfp_t gfp,
 	if (addr)
 		*handle = pfn_to_dma(dev, page_to_pfn(page));
 	else
-		__dma_free_buffer(page, size);
+		__dma_free_buffer(dev, page, size);
 
 	return addr;
 }
@@ -418,7 +451,7 @@ void dma_free_coherent(struct device *dev, size_t size, void *cpu_addr, dma_addr
 	if (!arch_is_coherent())
 		__dma_free_remap(cpu_addr, size);
 
-	__dma_free_buffer(pfn_to_page(dma_to_pfn(dev, handle)), size);
+	__dma_free_buffer(dev, pfn_to_page(dma_to_pfn(dev, handle)), size);
 }
 EXPORT_SYMBOL(dma_free_coherent);
 
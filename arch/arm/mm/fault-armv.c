@@ -109,7 +109,7 @@ static int adjust_pte(struct vm_area_struct *vma, unsigned long address,
 		return 0;
 
 	pmd = pmd_offset(pud, address);
-	if (pmd_none_or_clear_bad(pmd))
+	if (pmd_none_or_clear_bad(pmd) || pmd_trans_huge(*pmd))
 		return 0;
 
 	/*
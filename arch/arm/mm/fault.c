@@ -116,6 +116,9 @@ void show_pte(struct mm_struct *mm, unsigned long addr)
 			break;
 		}
 
+		if (pmd_trans_huge(*pmd))
+			break;
+
 		/* We must not map this if we have highmem enabled */
 		if (PageHighMem(pfn_to_page(pmd_val(*pmd) >> PAGE_SHIFT)))
 			break;
@@ -212,20 +215,28 @@ void do_bad_area(unsigned long addr, unsigned int fsr, struct pt_regs *regs)
 #define VM_FAULT_BADACCESS	0x020000
 
 /*
- * Check that the permissions on the VMA allow for the fault which occurred.
- * If we encountered a write fault, we must have write permission, otherwise
+ * The VMA permissions that allow for the fault which occurred.  If we
+ * encountered a write fault, we must have write permission, otherwise
  * we allow any permission.
  */
-static inline bool access_error(unsigned int fsr, struct vm_area_struct *vma)
+static inline unsigned long fault_vm_access(unsigned int fsr)
 {
-	unsigned int mask = VM_READ | VM_WRITE | VM_EXEC;
+	unsigned long mask = VM_READ | VM_WRITE | VM_EXEC;
 
 	if (fsr & FSR_WRITE)
 		mask = VM_WRITE;
 	if (fsr & FSR_LNX_PF)
 		mask = VM_EXEC;
 
-	return vma->vm_flags & mask ? false : true;
+	return mask;
+}
+
+/*
+ * Check that the permissions on the VMA allow for the fault which occurred.
+ */
+static inline bool access_error(unsigned int fsr, struct vm_area_struct *vma)
+{
+	return vma->vm_flags & fault_vm_access(fsr) ? false : true;
 }
 
 static int __kprobes
@@ -294,6 +305,26 @@ do_page_fault(unsigned long addr, unsigned int fsr, struct pt_regs *regs)
 	if (in_atomic() || !mm)
 		goto no_context;
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+	/*
+	 * Try first without mmap_sem, so that a thread sleeping in mmap()
+	 * or munmap() does not hold up every other thread faulting in this
+	 * mm.  Kernel faults must come from a uaccess to be handled here.
+	 */
+	if (user_mode(regs) || search_exception_tables(regs->ARM_pc)) {
+		fault = handle_speculative_fault(mm, addr & PAGE_MASK,
+				(fsr & FSR_WRITE) ? FAULT_FLAG_WRITE : 0,
+				fault_vm_access(fsr));
+		if (!(fault & VM_FAULT_RETRY)) {
+			if (fault & VM_FAULT_MAJOR)
+				tsk->maj_flt++;
+			else
+				tsk->min_flt++;
+			goto done;
+		}
+	}
+#endif
+
 	/*
 	 * As per x86, we may deadlock here.  However, since the kernel only
 	 * validly references user space from well defined areas of the code,
@@ -320,6 +351,9 @@ do_page_fault(unsigned long addr, unsigned int fsr, struct pt_regs *regs)
 	fault = __do_page_fault(mm, addr, fsr, tsk);
 	up_read(&mm->mmap_sem);
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+done:
+#endif
 	perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS, 1, 0, regs, addr);
 	if (fault & VM_FAULT_MAJOR)
 		perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS_MAJ, 1, 0, regs, addr);
@@ -469,10 +503,18 @@ do_translation_fault(unsigned long addr, unsigned int fsr,
 /*
  * Some section permission faults need to be handled gracefully.
  * They can happen due to a __{get,put}_user during an oops.
+ *
+ * With transparent huge pages, user memory may be mapped by sections
+ * too: write protection and young bit emulation faults on those go
+ * through the normal page fault path.
  */
 static int
 do_sect_fault(unsigned long addr, unsigned int fsr, struct pt_regs *regs)
 {
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	if (addr < TASK_SIZE)
+		return do_page_fault(addr, fsr, regs);
+#endif
 	do_bad_area(addr, fsr, regs);
 	return 0;
 }
@@ -0,0 +1,86 @@
+/*
+ *  linux/arch/arm/mm/huge_memory.c
+ *
+ *  Transparent huge page support for the two level page tables,
+ *  using a pair of 1MB sections per huge pmd.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+
+#include <asm/cacheflush.h>
+#include <asm/cachetype.h>
+#include <asm/pgtable.h>
+#include <asm/tlbflush.h>
+
+#include "mm.h"
+
+/*
+ * Huge pages are cleared and copied through the kernel mapping, so
+ * make that data visible before a section mapping is installed, the
+ * same way __sync_icache_dcache() does for small pages.
+ */
+static void __sync_icache_dcache_pmd(pmd_t pmd)
+{
+	struct page *page;
+	int exec = !(pmd_val(pmd) & PMD_SECT_XN);
+	int i;
+
+	if (cache_is_vipt_nonaliasing() && !exec)
+		return;
+
+	page = pmd_page(pmd);
+	for (i = 0; i < HPAGE_PMD_NR; i++, page++)
+		if (!test_and_set_bit(PG_dcache_clean, &page->flags))
+			__flush_dcache_page(NULL, page);
+
+	if (exec)
+		__flush_icache_all();
+}
+
+void set_pmd_at(struct mm_struct *mm, unsigned long addr,
+		pmd_t *pmdp, pmd_t pmd)
+{
+	if (pmd_young(pmd))
+		__sync_icache_dcache_pmd(pmd);
+
+	pmdp[0] = pmd;
+	pmdp[1] = __pmd(pmd_val(pmd) + SECTION_SIZE);
+	flush_pmd_entry(pmdp);
+}
+
+pmd_t pmdp_get_and_clear(struct mm_struct *mm, unsigned long addr,
+			 pmd_t *pmdp)
+{
+	pmd_t pmd = *pmdp;
+
+	pmd_clear(pmdp);
+	return pmd;
+}
+
+void pmdp_splitting_flush(struct vm_area_struct *vma, unsigned long addr,
+			  pmd_t *pmdp)
+{
+	VM_BUG_ON(addr & ~HPAGE_PMD_MASK);
+	/*
+	 * The splitting bit does not change the access permissions and
+	 * there is no lockless get_user_pages_fast() to serialize
+	 * against, so no TLB flush is needed here.
+	 */
+	set_pmd_at(vma->vm_mm, addr, pmdp, pmd_mksplitting(*pmdp));
+}
+
+/*
+ * Each half of a huge pmd is a section, held in the TLB as a single
+ * entry, so one flush by address per section is enough; going through
+ * flush_tlb_range() would flush the range page by page.
+ */
+void flush_pmd_tlb_range(struct vm_area_struct *vma, unsigned long start,
+			 unsigned long end)
+{
+	for (start &= SECTION_MASK; start < end; start += SECTION_SIZE)
+		flush_tlb_page(vma, start);
+}
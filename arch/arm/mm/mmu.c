@@ -57,6 +57,10 @@ pgprot_t pgprot_kernel;
 EXPORT_SYMBOL(pgprot_user);
 EXPORT_SYMBOL(pgprot_kernel);
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+unsigned long pmd_user_sect_prot;
+#endif
+
 struct cachepolicy {
 	const char	policy[16];
 	unsigned int	cr_mask;
@@ -485,6 +489,18 @@ static void __init build_mem_type_table(void)
 	mem_types[MT_MEMORY_NONCACHED].prot_sect |= ecc_mask;
 	mem_types[MT_ROM].prot_sect |= cp->pmd;
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	/*
+	 * Huge user pages get the memory type of kernel lowmem and are
+	 * tagged with the ASID like any other user mapping.
+	 */
+	pmd_user_sect_prot = (mem_types[MT_MEMORY].prot_sect &
+			      (PMD_SECT_TEX(7) | PMD_SECT_CACHEABLE |
+			       PMD_SECT_BUFFERABLE | PMD_SECT_S)) |
+			     PMD_TYPE_SECT | PMD_SECT_nG |
+			     PMD_DOMAIN(DOMAIN_USER);
+#endif
+
 	switch (cp->pmd) {
 	case PMD_SECT_WT:
 		mem_types[MT_CACHECLEAN].prot_sect |= PMD_SECT_WT;
@@ -534,7 +550,7 @@ static pte_t * __init early_pte_alloc(pmd_t *pmd, unsigned long addr, unsigned l
 		pte_t *pte = early_alloc(PTE_HWTABLE_OFF + PTE_HWTABLE_SIZE);
 		__pmd_populate(pmd, __pa(pte), prot);
 	}
-	BUG_ON(pmd_bad(*pmd));
+	BUG_ON(pmd_bad(*pmd) || pmd_trans_huge(*pmd));
 	return pte_offset_kernel(pmd, addr);
 }
 
@@ -210,6 +210,10 @@ static inline int pmd_same(pmd_t pmd_a, pmd_t pmd_b)
 #define flush_tlb_fix_spurious_fault(vma, address) flush_tlb_page(vma, address)
 #endif
 
+#ifndef flush_pmd_tlb_range
+#define flush_pmd_tlb_range(vma, start, end) flush_tlb_range(vma, start, end)
+#endif
+
 #ifndef pgprot_noncached
 #define pgprot_noncached(prot)	(prot)
 #endif
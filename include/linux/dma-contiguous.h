@@ -0,0 +1,89 @@
+#ifndef __LINUX_CMA_H
+#define __LINUX_CMA_H
+
+/*
+ * Contiguous Memory Allocator for DMA mapping framework
+ *
+ * The Contiguous Memory Allocator (CMA) makes it possible for device
+ * drivers to allocate big physically-contiguous blocks of memory, as
+ * video and camera devices on embedded systems need, without
+ * permanently reserving the memory at boot time.
+ *
+ * At boot, dma_contiguous_reserve() takes an area from memblock.  Its
+ * pageblocks are then given to the page allocator as MIGRATE_CMA,
+ * so that they serve movable allocations only.  When a driver
+ * allocates from the area, the pages in the requested range are
+ * migrated away with alloc_contig_range(), which uses compaction's
+ * scanners and migrate_pages().
+ *
+ * The default area serves all devices; dma_declare_contiguous() lets
+ * board code reserve a private area for a device.  The default size
+ * is CONFIG_CMA_SIZE_MBYTES, and the "cma=" kernel parameter
+ * overrides it.
+ *
+ * Architectures hook dma_alloc_from_contiguous() and
+ * dma_release_from_contiguous() into their dma_alloc_coherent()
+ * implementation, and call dma_contiguous_reserve() once memblock is
+ * set up.
+ */
+
+#ifdef __KERNEL__
+
+#include <linux/types.h>
+#include <linux/errno.h>
+
+struct cma;
+struct page;
+struct device;
+
+#ifdef CONFIG_CMA
+
+/*
+ * There is always at least global CMA area and a few optional device
+ * private areas configured in kernel .config.
+ */
+#define MAX_CMA_AREAS	(1 + CONFIG_CMA_AREAS)
+
+extern struct cma *dma_contiguous_default_area;
+
+void dma_contiguous_reserve(phys_addr_t addr_limit);
+int dma_declare_contiguous(struct device *dev, unsigned long size,
+			   phys_addr_t base, phys_addr_t limit);
+
+struct page *dma_alloc_from_contiguous(struct device *dev, int count,
+				       unsigned int order);
+bool dma_release_from_contiguous(struct device *dev, struct page *pages,
+				 int count);
+
+#else
+
+#define MAX_CMA_AREAS	(0)
+
+static inline void dma_contiguous_reserve(phys_addr_t limit) { }
+
+static inline
+int dma_declare_contiguous(struct device *dev, unsigned long size,
+			   phys_addr_t base, phys_addr_t limit)
+{
+	return -ENOSYS;
+}
+
+static inline
+struct page *dma_alloc_from_contiguous(struct device *dev, int count,
+				       unsigned int order)
+{
+	return NULL;
+}
+
+static inline
+bool dma_release_from_contiguous(struct device *dev, struct page *pages,
+				 int count)
+{
+	return false;
+}
+
+#endif
+
+#endif
+
+#endif
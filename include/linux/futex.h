@@ -185,6 +185,18 @@ static inline void exit_pi_state_list(struct task_struct *curr)
 {
 }
 #endif
+
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+extern void futex_private_hash_alloc(struct mm_struct *mm);
+extern void futex_private_hash_free(struct mm_struct *mm);
+#else
+static inline void futex_private_hash_alloc(struct mm_struct *mm)
+{
+}
+static inline void futex_private_hash_free(struct mm_struct *mm)
+{
+}
+#endif
 #endif /* __KERNEL__ */
 
 #define FUTEX_OP_SET		0	/* *(int *)UADDR2 = OPARG; */
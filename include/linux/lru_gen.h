@@ -0,0 +1,37 @@
+#ifndef _LINUX_LRU_GEN_H
+#define _LINUX_LRU_GEN_H
+
+#include <linux/mm_types.h>
+
+#ifdef CONFIG_LRU_GEN
+extern int lru_gen_enabled;
+
+extern void lru_gen_add_mm(struct mm_struct *mm);
+extern void lru_gen_del_mm(struct mm_struct *mm);
+extern void lru_gen_init_page(struct page *page);
+extern int lru_gen_page_age(struct page *page);
+extern void lru_gen_maybe_age(int force);
+#else /* CONFIG_LRU_GEN */
+static inline void lru_gen_add_mm(struct mm_struct *mm)
+{
+}
+
+static inline void lru_gen_del_mm(struct mm_struct *mm)
+{
+}
+
+static inline void lru_gen_init_page(struct page *page)
+{
+}
+
+static inline int lru_gen_page_age(struct page *page)
+{
+	return -1;
+}
+
+static inline void lru_gen_maybe_age(int force)
+{
+}
+#endif /* CONFIG_LRU_GEN */
+
+#endif /* _LINUX_LRU_GEN_H */
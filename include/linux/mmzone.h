@@ -40,8 +40,26 @@
 #define MIGRATE_MOVABLE       2
 #define MIGRATE_PCPTYPES      3 /* the number of types on the pcp lists */
 #define MIGRATE_RESERVE       3
+#ifdef CONFIG_CMA
+/*
+ * MIGRATE_CMA pageblocks belong to a contiguous memory area.  Only
+ * movable pages are allocated from them, so that alloc_contig_range()
+ * can always migrate the pages away and hand the whole range to a
+ * device driver.
+ */
+#define MIGRATE_CMA           4
+#define MIGRATE_ISOLATE       5 /* can't allocate from here */
+#define MIGRATE_TYPES         6
+#else
 #define MIGRATE_ISOLATE       4 /* can't allocate from here */
 #define MIGRATE_TYPES         5
+#endif
+
+#ifdef CONFIG_CMA
+#  define is_migrate_cma(migratetype) unlikely((migratetype) == MIGRATE_CMA)
+#else
+#  define is_migrate_cma(migratetype) false
+#endif
 
 #define for_each_migratetype_order(order, type) \
 	for (order = 0; order < MAX_ORDER; order++) \
@@ -130,6 +148,13 @@ enum zone_stat_item {
 #define LRU_ACTIVE 1
 #define LRU_FILE 2
 
+/*
+ * Number of generations the multi-generational LRU tells apart: a
+ * mapped page is of age 0 when it was accessed since the last aging
+ * pass, and gets one older with every pass that finds it untouched.
+ */
+#define MAX_NR_GENS 4
+
 enum lru_list {
 	LRU_INACTIVE_ANON = LRU_BASE,
 	LRU_ACTIVE_ANON = LRU_BASE + LRU_ACTIVE,
@@ -187,9 +212,17 @@ struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
 	int batch;		/* chunk size for buddy add/remove */
+	int base_batch;		/* batch from zone size, 0 if not adaptive */
+	int batch_stable;	/* bulk operations since batch last changed */
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	/* zone->lock statistics of the bulk operations on this list */
+	unsigned long lock_acquired;
+	unsigned long lock_contended;
+	u64 lock_wait_ns;
+	u64 lock_hold_ns;
 };
 
 struct per_cpu_pageset {
@@ -372,6 +405,14 @@ struct zone {
 	 */
 	unsigned int inactive_ratio;
 
+#ifdef CONFIG_LRU_GEN
+	/*
+	 * Mapped pages the last page table walk of mm/lru_gen.c moved
+	 * into the youngest [0] and the oldest [1] generation, per type
+	 * (anon, file).
+	 */
+	unsigned long		lru_gen_pages[2][2];
+#endif
 
 	ZONE_PADDING(_pad2_)
 	/* Rarely used or read-mostly fields */
@@ -650,6 +691,13 @@ typedef struct pglist_data {
 	struct task_struct *kswapd;	/* Protected by lock_memory_hotplug() */
 	int kswapd_max_order;
 	enum zone_type classzone_idx;
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+	/*
+	 * Struct pages of the node's highest zone from this pfn on are
+	 * initialised by page_alloc_init_late(), see memmap_init_zone()
+	 */
+	unsigned long first_deferred_pfn;
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
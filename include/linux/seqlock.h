@@ -165,6 +165,22 @@ static inline unsigned read_seqcount_begin(const seqcount_t *s)
 	return ret;
 }
 
+/**
+ * raw_read_seqcount - read the sequence count without waiting
+ * @s: pointer to seqcount_t
+ * Returns: count to be passed to read_seqcount_retry
+ *
+ * raw_read_seqcount is like read_seqcount_begin, but does not spin while
+ * a writer is active.  The caller must check the low bit of the result
+ * and back off itself if it is set.
+ */
+static inline unsigned raw_read_seqcount(const seqcount_t *s)
+{
+	unsigned ret = ACCESS_ONCE(s->sequence);
+	smp_rmb();
+	return ret;
+}
+
 /**
  * __read_seqcount_retry - end a seq-read critical section (without barrier)
  * @s: pointer to seqcount_t
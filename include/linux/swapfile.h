@@ -0,0 +1,11 @@
+#ifndef _LINUX_SWAPFILE_H
+#define _LINUX_SWAPFILE_H
+
+/*
+ * swap_info used to be static in swapfile.c, but frontswap.c needs to
+ * look up the swap area of a page; keep it out of swap.h so the dozens
+ * of files that include that do not see it.
+ */
+extern struct swap_info_struct *swap_info[];
+
+#endif /* _LINUX_SWAPFILE_H */
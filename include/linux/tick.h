@@ -45,6 +45,9 @@ enum tick_nohz_mode {
  * @iowait_sleeptime:	Sum of the time slept in idle with sched tick stopped, with IO outstanding
  * @sleep_length:	Duration of the current idle sleep
  * @do_timer_lst:	CPU was the last one doing do_timer before going idle
+ * @full_jiffies:	jiffies up to which a busy CPU's stopped tick has been
+ *			accounted
+ * @full_stops:		Number of times the tick was stopped while busy
  */
 struct tick_sched {
 	struct hrtimer			sched_timer;
@@ -67,6 +70,10 @@ struct tick_sched {
 	unsigned long			next_jiffies;
 	ktime_t				idle_expires;
 	int				do_timer_last;
+#ifdef CONFIG_NO_HZ_FULL
+	unsigned long			full_jiffies;
+	unsigned long			full_stops;
+#endif
 };
 
 extern void __init tick_init(void);
@@ -139,4 +146,44 @@ static inline u64 get_cpu_idle_time_us(int cpu, u64 *unused) { return -1; }
 static inline u64 get_cpu_iowait_time_us(int cpu, u64 *unused) { return -1; }
 # endif /* !NO_HZ */
 
+# ifdef CONFIG_NO_HZ_FULL
+extern bool tick_nohz_full_running;
+extern cpumask_var_t tick_nohz_full_mask;
+
+static inline bool tick_nohz_full_cpu(int cpu)
+{
+	if (!tick_nohz_full_running)
+		return false;
+
+	return cpumask_test_cpu(cpu, tick_nohz_full_mask);
+}
+
+extern void __tick_nohz_full_check(void);
+extern void __tick_nohz_task_switch_out(struct task_struct *prev);
+extern void __tick_nohz_task_switch(void);
+
+static inline void tick_nohz_full_check(void)
+{
+	if (tick_nohz_full_running)
+		__tick_nohz_full_check();
+}
+
+static inline void tick_nohz_task_switch_out(struct task_struct *prev)
+{
+	if (tick_nohz_full_running)
+		__tick_nohz_task_switch_out(prev);
+}
+
+static inline void tick_nohz_task_switch(void)
+{
+	if (tick_nohz_full_running)
+		__tick_nohz_task_switch();
+}
+# else
+static inline bool tick_nohz_full_cpu(int cpu) { return false; }
+static inline void tick_nohz_full_check(void) { }
+static inline void tick_nohz_task_switch_out(struct task_struct *prev) { }
+static inline void tick_nohz_task_switch(void) { }
+# endif /* !NO_HZ_FULL */
+
 #endif
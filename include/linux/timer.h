@@ -229,6 +229,18 @@ extern void set_timer_slack(struct timer_list *time, int slack_hz);
  */
 extern unsigned long get_next_timer_interrupt(unsigned long now);
 
+/*
+ * Occupancy of one level of a CPU's timer wheel, for /proc/timer_list:
+ */
+struct timer_wheel_stats {
+	unsigned long	granularity;	/* jiffies covered by one bucket */
+	unsigned int	buckets;	/* buckets holding timers */
+	unsigned int	timers;		/* timers queued on the level */
+};
+
+extern int timer_wheel_get_stats(int cpu, int lvl,
+				 struct timer_wheel_stats *stats);
+
 /*
  * Timer-statistics info:
  */
@@ -259,7 +259,13 @@ static inline void dst_use(struct dst_entry *dst, unsigned long time)
 static inline void dst_use_noref(struct dst_entry *dst, unsigned long time)
 {
 	dst->__use++;
-	dst->lastuse = time;
+	/*
+	 * Called for every packet taking the input route cache: __use
+	 * keeps counting packets, but lastuse is only stored when the
+	 * jiffy changes.
+	 */
+	if (time != dst->lastuse)
+		dst->lastuse = time;
 }
 
 static inline
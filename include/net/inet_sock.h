@@ -106,6 +106,7 @@ struct inet_cork {
 	struct page		*page;
 	u32			off;
 	u8			tx_flags;
+	__u16			gso_size;
 };
 
 struct inet_cork_full {
@@ -133,6 +134,7 @@ struct rtable;
  * @mc_ttl - Multicasting TTL
  * @is_icsk - is this an inet_connection_sock?
  * @mc_index - Multicast device index
+ * @rx_dst_ifindex - Input device of the route cached in sk_rx_dst
  * @mc_list - Group array
  * @cork - info to build ip hdr on each ip frag while socket is corked
  */
@@ -168,6 +170,7 @@ struct inet_sock {
 				mc_all:1,
 				nodefrag:1;
 	int			mc_index;
+	int			rx_dst_ifindex;
 	__be32			mc_addr;
 	struct ip_mc_socklist __rcu	*mc_list;
 	struct inet_cork_full	cork;
@@ -44,6 +44,8 @@ struct inet_skb_parm {
 #define IPSKB_REROUTED		16
 };
 
+#define IP_MAX_MTU	0xFFF0
+
 static inline unsigned int ip_hdrlen(const struct sk_buff *skb)
 {
 	return ip_hdr(skb)->ihl * 4;
@@ -54,6 +56,7 @@ struct ipcm_cookie {
 	int			oif;
 	struct ip_options_rcu	*opt;
 	__u8			tx_flags;
+	__u16			gso_size;
 };
 
 #define IPCB(skb) ((struct inet_skb_parm*)((skb)->cb))
@@ -130,6 +133,7 @@ extern struct sk_buff  *ip_make_skb(struct sock *sk,
 				    void *from, int length, int transhdrlen,
 				    struct ipcm_cookie *ipc,
 				    struct rtable **rtp,
+				    struct inet_cork *cork,
 				    unsigned int flags);
 
 static inline struct sk_buff *ip_finish_skb(struct sock *sk, struct flowi4 *fl4)
@@ -234,6 +238,9 @@ extern int inet_peer_gc_maxtime;
 /* From ip_output.c */
 extern int sysctl_ip_dynaddr;
 
+/* From ip_input.c */
+extern int sysctl_ip_early_demux;
+
 extern void ipfrag_init(void);
 
 extern void ip_static_sysctl_init(void);
@@ -60,6 +60,8 @@
 #include <linux/pid.h>
 #include <linux/nsproxy.h>
 #include <linux/ptrace.h>
+#include <linux/bootmem.h>
+#include <linux/log2.h>
 
 #include <asm/futex.h>
 
@@ -67,8 +69,6 @@
 
 int __read_mostly futex_cmpxchg_enabled;
 
-#define FUTEX_HASHBITS (CONFIG_BASE_SMALL ? 4 : 8)
-
 /*
  * Futex flags used to encode options to functions and preserve them across
  * restarts.
@@ -148,7 +148,25 @@ struct futex_hash_bucket {
 	struct plist_head chain;
 };
 
-static struct futex_hash_bucket futex_queues[1<<FUTEX_HASHBITS];
+/*
+ * The global hash is sized at boot from the number of possible CPUs, so
+ * that unrelated futexes on a big machine rarely share a bucket lock.
+ */
+static unsigned long __read_mostly futex_hashsize;
+static struct futex_hash_bucket *futex_queues __read_mostly;
+
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+/*
+ * Hash table for the PROCESS_PRIVATE futexes of one mm, so that they do
+ * not share buckets with those of other processes.
+ */
+struct futex_private_hash {
+	unsigned long mask;
+	struct futex_hash_bucket queues[0];
+};
+
+#define FUTEX_PRIVATE_HASH_MIN	16
+#endif
 
 /*
  * We hash on the keys returned from get_futex_key (see below).
@@ -158,9 +176,60 @@ static struct futex_hash_bucket *hash_futex(union futex_key *key)
 	u32 hash = jhash2((u32*)&key->both.word,
 			  (sizeof(key->both.word)+sizeof(key->both.ptr))/4,
 			  key->both.offset);
-	return &futex_queues[hash & ((1 << FUTEX_HASHBITS)-1)];
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+	if (!(key->both.offset & (FUT_OFF_INODE | FUT_OFF_MMSHARED))) {
+		struct futex_private_hash *fph = key->private.mm->futex_hash;
+
+		if (fph)
+			return &fph->queues[hash & fph->mask];
+	}
+#endif
+	return &futex_queues[hash & (futex_hashsize - 1)];
 }
 
+#ifdef CONFIG_FUTEX_PRIVATE_HASH
+/**
+ * futex_private_hash_alloc() - Give an mm its own private futex hash
+ * @mm:		the mm about to get its second thread
+ *
+ * Called when the first thread sharing @mm is created.  The table must
+ * be in place before two tasks can use @mm, as a private futex has to
+ * hash to the same bucket for all of them; if the allocation fails, the
+ * mm simply keeps using the global hash.
+ */
+void futex_private_hash_alloc(struct mm_struct *mm)
+{
+	struct futex_private_hash *fph;
+	unsigned long i, size;
+
+	if (mm->futex_hash || atomic_read(&mm->mm_users) != 1)
+		return;
+
+	size = roundup_pow_of_two(max_t(unsigned long, FUTEX_PRIVATE_HASH_MIN,
+					4 * num_possible_cpus()));
+	fph = kmalloc(sizeof(*fph) + size * sizeof(fph->queues[0]),
+		      GFP_KERNEL);
+	if (!fph)
+		return;
+
+	fph->mask = size - 1;
+	for (i = 0; i < size; i++) {
+		plist_head_init(&fph->queues[i].chain, &fph->queues[i].lock);
+		spin_lock_init(&fph->queues[i].lock);
+	}
+	mm->futex_hash = fph;
+}
+
+/**
+ * futex_private_hash_free() - Free the private futex hash of an mm
+ * @mm:		the mm being freed
+ */
+void futex_private_hash_free(struct mm_struct *mm)
+{
+	kfree(mm->futex_hash);
+}
+#endif
+
 /*
  * Return 1 if two futex_keys are equal, 0 otherwise.
  */
@@ -2741,8 +2810,21 @@ SYSCALL_DEFINE6(futex, u32 __user *, uaddr, int, op, u32, val,
 
 static int __init futex_init(void)
 {
+	unsigned int futex_shift;
+	unsigned long i;
 	u32 curval;
-	int i;
+
+#if CONFIG_BASE_SMALL
+	futex_hashsize = 16;
+#else
+	futex_hashsize = roundup_pow_of_two(256 * num_possible_cpus());
+#endif
+	futex_queues = alloc_large_system_hash("futex", sizeof(*futex_queues),
+					       futex_hashsize, 0,
+					       futex_hashsize < 256 ? HASH_SMALL : 0,
+					       &futex_shift, NULL,
+					       futex_hashsize);
+	futex_hashsize = 1UL << futex_shift;
 
 	/*
 	 * This will fail and we want it. Some arch implementations do
@@ -2757,7 +2839,7 @@ static int __init futex_init(void)
 	if (cmpxchg_futex_value_locked(&curval, NULL, 0, 0) == -EFAULT)
 		futex_cmpxchg_enabled = 1;
 
-	for (i = 0; i < ARRAY_SIZE(futex_queues); i++) {
+	for (i = 0; i < futex_hashsize; i++) {
 		plist_head_init(&futex_queues[i].chain, &futex_queues[i].lock);
 		spin_lock_init(&futex_queues[i].lock);
 	}
@@ -1371,6 +1371,22 @@ void run_posix_cpu_timers(struct task_struct *tsk)
 	}
 }
 
+/*
+ * Can the tick of a CPU running @tsk be stopped? Not while the task or its
+ * thread group has CPU timers armed: they are only checked from the tick.
+ */
+bool posix_cpu_timers_can_stop_tick(struct task_struct *tsk)
+{
+	if (!task_cputime_zero(&tsk->cputime_expires))
+		return false;
+
+	/* Accessed without locking, like in fastpath_timer_check() */
+	if (tsk->signal->cputimer.running)
+		return false;
+
+	return true;
+}
+
 /*
  * Set one of the process-wide special case CPU timers or RLIMIT_CPU.
  * The tsk->sighand->siglock must be held by the caller.
@@ -41,6 +41,7 @@
 #include <linux/cpu.h>
 #include <linux/notifier.h>
 #include <linux/rculist.h>
+#include <linux/kthread.h>
 
 #include <asm/uaccess.h>
 
@@ -98,7 +99,8 @@ static int console_locked, console_suspended;
 /*
  * logbuf_lock protects log_buf, log_start, log_end, con_start and logged_chars
  * It is also used in interesting ways to provide interlocking in
- * console_unlock();.
+ * console_unlock();.  printk() itself never waits for it: messages are
+ * queued in printk_rb and moved into log_buf by whoever holds the lock.
  */
 static DEFINE_SPINLOCK(logbuf_lock);
 
@@ -142,6 +144,22 @@ EXPORT_SYMBOL(console_set_on_cmdline);
 /* Flag: console code may call schedule() */
 static int console_may_schedule;
 
+/*
+ * Once running, this kthread writes printk() output to the consoles on
+ * behalf of the callers.  See printk_sync_output() for when it is not used.
+ */
+static struct task_struct *printk_kthread;
+static DECLARE_WAIT_QUEUE_HEAD(printk_kthread_wait);
+
+/*
+ * Wakeups printk() can't do itself, since it may be called with
+ * scheduler locks held; printk_tick() does them on the next tick.
+ */
+#define PRINTK_PENDING_WAKEUP	0x01	/* wake up klogd */
+#define PRINTK_PENDING_OUTPUT	0x02	/* wake up the printk kthread */
+
+static DEFINE_PER_CPU(int, printk_pending);
+
 #ifdef CONFIG_PRINTK
 
 static char __log_buf[__LOG_BUF_LEN];
@@ -150,6 +168,93 @@ static int log_buf_len = __LOG_BUF_LEN;
 static unsigned logged_chars; /* Number of chars produced since last read+clear operation */
 static int saved_console_loglevel = -1;
 
+/*
+ * printk() formats each message straight into a record reserved in
+ * printk_rb, a lockless ring shared by all writers.  A record is reserved
+ * by advancing printk_rb_head with a single cmpxchg, which also hands out
+ * its sequence number, and is published by setting PRINTK_REC_COMMITTED.
+ * Whoever holds logbuf_lock moves committed records into log_buf in
+ * sequence order, so writers never wait for one another or for the
+ * consoles.  When the ring is full the message is dropped and counted.
+ */
+#define PRINTK_RB_LEN		(__LOG_BUF_LEN >> 2)
+#define PRINTK_REC_ALIGN	8
+#define PRINTK_LINE_MAX		1024
+
+#define PRINTK_REC_COMMITTED	0x01	/* record may be consumed */
+#define PRINTK_REC_PAD		0x02	/* skip to the start of the ring */
+
+struct printk_rec {
+	u32	flags;		/* PRINTK_REC_*, set last */
+	u32	seq;		/* reservation order */
+	u64	ts_nsec;	/* cpu_clock() when printk() was called */
+	u16	size;		/* bytes taken in the ring, header included */
+	u16	text_len;	/* length of text, without the NUL */
+	char	text[0];
+};
+
+static char printk_rb_buf[PRINTK_RB_LEN] __aligned(PRINTK_REC_ALIGN);
+/* Next sequence number in the upper, next free byte in the lower half */
+static atomic64_t printk_rb_head = ATOMIC64_INIT(0);
+/* First byte and sequence number not yet moved to log_buf; logbuf_lock */
+static u32 printk_rb_tail;
+static u32 printk_rb_seq;
+static atomic_t printk_rb_dropped = ATOMIC_INIT(0);
+
+static void printk_rb_drain(void);
+
+static inline int printk_rb_pending(void)
+{
+	return (u32)(atomic64_read(&printk_rb_head) >> 32) !=
+		ACCESS_ONCE(printk_rb_seq);
+}
+
+/*
+ * Reserve room for a message of text_len characters.  Returns NULL if
+ * the ring is full.  A record that would straddle the end of the ring
+ * is preceded by padding up to the end.
+ */
+static struct printk_rec *printk_rb_reserve(unsigned int text_len)
+{
+	struct printk_rec *rec;
+	unsigned int size, off, pad;
+	u64 old, new;
+	u32 pos, seq;
+
+	size = ALIGN(sizeof(*rec) + text_len + 1, PRINTK_REC_ALIGN);
+	do {
+		old = atomic64_read(&printk_rb_head);
+		pos = (u32)old;
+		seq = old >> 32;
+		off = pos & (PRINTK_RB_LEN - 1);
+		pad = off + size > PRINTK_RB_LEN ? PRINTK_RB_LEN - off : 0;
+		if (pos + pad + size - ACCESS_ONCE(printk_rb_tail) >
+		    PRINTK_RB_LEN)
+			return NULL;
+		new = ((u64)(seq + 1) << 32) | (u32)(pos + pad + size);
+	} while (atomic64_cmpxchg(&printk_rb_head, old, new) != old);
+
+	/* Padding too short for a header is skipped by the reader anyway */
+	if (pad >= sizeof(*rec)) {
+		rec = (struct printk_rec *)&printk_rb_buf[off];
+		rec->size = pad;
+		smp_wmb();
+		ACCESS_ONCE(rec->flags) = PRINTK_REC_PAD | PRINTK_REC_COMMITTED;
+	}
+
+	rec = (struct printk_rec *)
+		&printk_rb_buf[(pos + pad) & (PRINTK_RB_LEN - 1)];
+	rec->seq = seq;
+	rec->size = size;
+	return rec;
+}
+
+static void printk_rb_commit(struct printk_rec *rec)
+{
+	smp_wmb();
+	ACCESS_ONCE(rec->flags) = PRINTK_REC_COMMITTED;
+}
+
 #ifdef CONFIG_KEXEC
 /*
  * This appends the listed symbols to /proc/vmcoreinfo
@@ -361,11 +466,12 @@ int do_syslog(int type, char __user *buf, int len, bool from_file)
 			goto out;
 		}
 		error = wait_event_interruptible(log_wait,
-							(log_start - log_end));
+				(log_start - log_end) || printk_rb_pending());
 		if (error)
 			goto out;
 		i = 0;
 		spin_lock_irq(&logbuf_lock);
+		printk_rb_drain();
 		while (!error && (log_start != log_end) && i < len) {
 			c = LOG_BUF(log_start);
 			log_start++;
@@ -400,6 +506,7 @@ int do_syslog(int type, char __user *buf, int len, bool from_file)
 		if (count > log_buf_len)
 			count = log_buf_len;
 		spin_lock_irq(&logbuf_lock);
+		printk_rb_drain();
 		if (count > logged_chars)
 			count = logged_chars;
 		if (do_clear)
@@ -469,7 +576,10 @@ int do_syslog(int type, char __user *buf, int len, bool from_file)
 		break;
 	/* Number of chars in the log buffer */
 	case SYSLOG_ACTION_SIZE_UNREAD:
+		spin_lock_irq(&logbuf_lock);
+		printk_rb_drain();
 		error = log_end - log_start;
+		spin_unlock_irq(&logbuf_lock);
 		break;
 	/* Size of the log buffer */
 	case SYSLOG_ACTION_SIZE_BUFFER:
@@ -622,10 +732,12 @@ static size_t log_prefix(const char *p, unsigned int *level, char *special)
  * log_buf[start] to log_buf[end - 1].
  * The console_lock must be held.
  */
+static int console_msg_level = -1;
+
 static void call_console_drivers(unsigned start, unsigned end)
 {
 	unsigned cur_index, start_print;
-	static int msg_level = -1;
+	int msg_level = console_msg_level;
 
 	BUG_ON(((int)(start - end)) > 0);
 
@@ -670,6 +782,25 @@ static void call_console_drivers(unsigned start, unsigned end)
 		}
 	}
 	_call_console_drivers(start_print, end, msg_level);
+	console_msg_level = msg_level;
+}
+
+/*
+ * The printk kthread writes at most this much at a time, rounded up to
+ * the end of a line, so that it does not keep interrupts off for long.
+ */
+#define PRINTK_CONSOLE_CHUNK	128
+
+static unsigned console_chunk_end(unsigned start, unsigned end)
+{
+	unsigned i;
+
+	if (current != printk_kthread || end - start <= PRINTK_CONSOLE_CHUNK)
+		return end;
+	for (i = start + PRINTK_CONSOLE_CHUNK; i != end; i++)
+		if (LOG_BUF(i - 1) == '\n')
+			break;
+	return i;
 }
 
 static void emit_log_char(char c)
@@ -816,11 +947,7 @@ static int console_trylock_for_printk(unsigned int cpu)
 	spin_unlock(&logbuf_lock);
 	return retval;
 }
-static const char recursion_bug_msg [] =
-		KERN_CRIT "BUG: recent printk recursion!\n";
-static int recursion_bug;
 static int new_text_line = 1;
-static char printk_buf[1024];
 
 int printk_delay_msec __read_mostly;
 
@@ -836,57 +963,18 @@ static inline void printk_delay(void)
 	}
 }
 
-asmlinkage int vprintk(const char *fmt, va_list args)
+/*
+ * Copy the text of one message into log_buf, starting a new line with
+ * its log prefix and time stamp where needed.  Called with logbuf_lock
+ * held.
+ */
+static void emit_log_text(const char *text, u64 ts_nsec)
 {
-	int printed_len = 0;
 	int current_log_level = default_message_loglevel;
-	unsigned long flags;
-	int this_cpu;
-	char *p;
+	const char *p = text;
 	size_t plen;
 	char special;
 
-	boot_delay_msec();
-	printk_delay();
-
-	preempt_disable();
-	/* This stops the holder of console_sem just where we want him */
-	raw_local_irq_save(flags);
-	this_cpu = smp_processor_id();
-
-	/*
-	 * Ouch, printk recursed into itself!
-	 */
-	if (unlikely(printk_cpu == this_cpu)) {
-		/*
-		 * If a crash is occurring during printk() on this CPU,
-		 * then try to get the crash message out but make sure
-		 * we can't deadlock. Otherwise just return to avoid the
-		 * recursion and return - but flag the recursion so that
-		 * it can be printed at the next appropriate moment:
-		 */
-		if (!oops_in_progress) {
-			recursion_bug = 1;
-			goto out_restore_irqs;
-		}
-		zap_locks();
-	}
-
-	lockdep_off();
-	spin_lock(&logbuf_lock);
-	printk_cpu = this_cpu;
-
-	if (recursion_bug) {
-		recursion_bug = 0;
-		strcpy(printk_buf, recursion_bug_msg);
-		printed_len = strlen(recursion_bug_msg);
-	}
-	/* Emit the output into the temporary buffer */
-	printed_len += vscnprintf(printk_buf + printed_len,
-				  sizeof(printk_buf) - printed_len, fmt, args);
-
-	p = printk_buf;
-
 	/* Read log level and handle special printk prefix */
 	plen = log_prefix(p, &current_log_level, &special);
 	if (plen) {
@@ -919,24 +1007,21 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 				int i;
 
 				for (i = 0; i < plen; i++)
-					emit_log_char(printk_buf[i]);
-				printed_len += plen;
+					emit_log_char(text[i]);
 			} else {
 				/* Add log prefix */
 				emit_log_char('<');
 				emit_log_char(current_log_level + '0');
 				emit_log_char('>');
-				printed_len += 3;
 			}
 
 			if (printk_time) {
-				/* Add the current time stamp */
+				/* Add the time stamp taken by printk() */
 				char tbuf[50], *tp;
 				unsigned tlen;
-				unsigned long long t;
+				unsigned long long t = ts_nsec;
 				unsigned long nanosec_rem;
 
-				t = cpu_clock(printk_cpu);
 				nanosec_rem = do_div(t, 1000000000);
 				tlen = sprintf(tbuf, "[%5lu.%06lu] ",
 						(unsigned long) t,
@@ -944,7 +1029,6 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 
 				for (tp = tbuf; tp < tbuf + tlen; tp++)
 					emit_log_char(*tp);
-				printed_len += tlen;
 			}
 
 			if (!*p)
@@ -955,6 +1039,172 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 		if (*p == '\n')
 			new_text_line = 1;
 	}
+}
+
+/*
+ * Move all committed records from printk_rb into log_buf, stopping at
+ * the first one that is still being written.  During an oops that
+ * record's writer may be the context that crashed, so it is skipped
+ * instead of holding up the oops text queued behind it.  Called with
+ * logbuf_lock held and interrupts disabled.
+ */
+static void printk_rb_drain(void)
+{
+	u32 head = (u32)atomic64_read(&printk_rb_head);
+	struct printk_rec *rec;
+	unsigned int off, size, dropped;
+
+	while (printk_rb_tail != head) {
+		off = printk_rb_tail & (PRINTK_RB_LEN - 1);
+		size = PRINTK_RB_LEN - off;
+		if (size >= sizeof(*rec)) {
+			rec = (struct printk_rec *)&printk_rb_buf[off];
+			if (!(ACCESS_ONCE(rec->flags) & PRINTK_REC_COMMITTED)) {
+				/* Can only skip it once its size is known */
+				if (!oops_in_progress || !rec->size ||
+				    rec->size > head - printk_rb_tail)
+					break;
+				printk_rb_seq = rec->seq + 1;
+			} else {
+				smp_rmb();
+				if (!(rec->flags & PRINTK_REC_PAD)) {
+					emit_log_text(rec->text, rec->ts_nsec);
+					printk_rb_seq = rec->seq + 1;
+				}
+			}
+			size = rec->size;
+		}
+		/* Writers must find a cleared header when they reuse this */
+		memset(&printk_rb_buf[off], 0, size);
+		smp_mb();
+		ACCESS_ONCE(printk_rb_tail) = printk_rb_tail + size;
+	}
+
+	dropped = atomic_xchg(&printk_rb_dropped, 0);
+	if (unlikely(dropped)) {
+		char buf[64];
+
+		snprintf(buf, sizeof(buf),
+			 KERN_WARNING "** %u printk messages dropped **\n",
+			 dropped);
+		emit_log_text(buf, cpu_clock(smp_processor_id()));
+	}
+}
+
+/*
+ * When the printk kthread can't be relied upon, the caller of printk()
+ * writes the consoles itself.  So that it does not pay for a long queue
+ * of other messages on a slow console, console output older than the
+ * last printk_emergency_backlog bytes is skipped; it stays in log_buf.
+ */
+static int printk_sync;
+module_param_named(synchronous, printk_sync, bool, S_IRUGO | S_IWUSR);
+
+static unsigned int printk_emergency_backlog = 4096;
+module_param_named(emergency_backlog, printk_emergency_backlog, uint,
+		   S_IRUGO | S_IWUSR);
+
+static inline int printk_sync_output(void)
+{
+	return !printk_kthread || printk_sync || oops_in_progress ||
+		system_state != SYSTEM_RUNNING;
+}
+
+/* Called with logbuf_lock held */
+static void printk_trim_console_backlog(void)
+{
+	unsigned start;
+
+	if (!printk_kthread || !printk_emergency_backlog ||
+	    log_end - con_start <= printk_emergency_backlog)
+		return;
+
+	/* Resume at the start of a line */
+	start = log_end - printk_emergency_backlog;
+	while (start != log_end && LOG_BUF(start - 1) != '\n')
+		start++;
+	con_start = start;
+	console_msg_level = -1;
+}
+
+static void printk_kthread_poke(void)
+{
+	this_cpu_or(printk_pending, PRINTK_PENDING_OUTPUT);
+}
+
+asmlinkage int vprintk(const char *fmt, va_list args)
+{
+	struct printk_rec *rec;
+	unsigned long flags;
+	va_list args2;
+	int printed_len = 0;
+	int this_cpu;
+	int len;
+
+	boot_delay_msec();
+	printk_delay();
+
+	va_copy(args2, args);
+	len = vsnprintf(NULL, 0, fmt, args2);
+	va_end(args2);
+	if (len >= PRINTK_LINE_MAX)
+		len = PRINTK_LINE_MAX - 1;
+
+	preempt_disable();
+	/*
+	 * This stops the holder of console_sem just where we want him,
+	 * and keeps an interrupt on this cpu from queueing its message
+	 * behind ours before ours is committed.
+	 */
+	raw_local_irq_save(flags);
+	this_cpu = smp_processor_id();
+
+	rec = printk_rb_reserve(len);
+	if (likely(rec)) {
+		rec->ts_nsec = cpu_clock(this_cpu);
+		rec->text_len = vscnprintf(rec->text, len + 1, fmt, args);
+		printed_len = rec->text_len;
+		printk_rb_commit(rec);
+	} else {
+		atomic_inc(&printk_rb_dropped);
+	}
+
+	if (!printk_sync_output()) {
+		/*
+		 * Move the message to log_buf if nobody else is at it, and
+		 * leave the consoles to the printk kthread.
+		 */
+		lockdep_off();
+		if (spin_trylock(&logbuf_lock)) {
+			printk_rb_drain();
+			spin_unlock(&logbuf_lock);
+		}
+		lockdep_on();
+		printk_kthread_poke();
+		goto out_restore_irqs;
+	}
+
+	/*
+	 * Ouch, printk recursed into itself!
+	 */
+	if (unlikely(printk_cpu == this_cpu)) {
+		/*
+		 * If a crash is occurring during printk() on this CPU,
+		 * then try to get the crash message out but make sure
+		 * we can't deadlock. Otherwise leave the message queued,
+		 * the current holder of logbuf_lock will pick it up.
+		 */
+		if (!oops_in_progress)
+			goto out_restore_irqs;
+		zap_locks();
+	}
+
+	lockdep_off();
+	spin_lock(&logbuf_lock);
+	printk_cpu = this_cpu;
+
+	printk_rb_drain();
+	printk_trim_console_backlog();
 
 	/*
 	 * Try to acquire and then immediately release the
@@ -979,12 +1229,55 @@ out_restore_irqs:
 EXPORT_SYMBOL(printk);
 EXPORT_SYMBOL(vprintk);
 
+static int printk_kthread_has_work(void)
+{
+	return !console_suspended &&
+		(printk_rb_pending() || con_start != log_end);
+}
+
+static int printk_kthread_func(void *unused)
+{
+	for (;;) {
+		wait_event_interruptible(printk_kthread_wait,
+					 printk_kthread_has_work());
+		console_lock();
+		console_unlock();
+	}
+	return 0;
+}
+
+static void __init printk_start_kthread(void)
+{
+	struct task_struct *t;
+
+	t = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(t)) {
+		printk(KERN_WARNING "printk: console output stays "
+		       "synchronous, could not start kthread\n");
+		return;
+	}
+	printk_kthread = t;
+}
+
 #else
 
 static void call_console_drivers(unsigned start, unsigned end)
 {
 }
 
+static unsigned console_chunk_end(unsigned start, unsigned end)
+{
+	return end;
+}
+
+static void printk_rb_drain(void)
+{
+}
+
+static void __init printk_start_kthread(void)
+{
+}
+
 #endif
 
 static int __add_preferred_console(char *name, int idx, char *options,
@@ -1214,13 +1507,15 @@ int is_console_locked(void)
 	return console_locked;
 }
 
-static DEFINE_PER_CPU(int, printk_pending);
-
 void printk_tick(void)
 {
 	if (__this_cpu_read(printk_pending)) {
-		__this_cpu_write(printk_pending, 0);
-		wake_up_interruptible(&log_wait);
+		int pending = __this_cpu_xchg(printk_pending, 0);
+
+		if (pending & PRINTK_PENDING_OUTPUT)
+			wake_up(&printk_kthread_wait);
+		if (pending & PRINTK_PENDING_WAKEUP)
+			wake_up_interruptible(&log_wait);
 	}
 }
 
@@ -1234,7 +1529,7 @@ int printk_needs_cpu(int cpu)
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
-		this_cpu_write(printk_pending, 1);
+		this_cpu_or(printk_pending, PRINTK_PENDING_WAKEUP);
 }
 
 /**
@@ -1266,17 +1561,34 @@ void console_unlock(void)
 
 	for ( ; ; ) {
 		spin_lock_irqsave(&logbuf_lock, flags);
+		printk_rb_drain();
 		wake_klogd |= log_start - log_end;
 		if (con_start == log_end)
 			break;			/* Nothing to print */
 		_con_start = con_start;
-		_log_end = log_end;
-		con_start = log_end;		/* Flush */
+		_log_end = console_chunk_end(con_start, log_end);
+		con_start = _log_end;		/* Flush */
 		spin_unlock(&logbuf_lock);
 		stop_critical_timings();	/* don't trace print latency */
 		call_console_drivers(_con_start, _log_end);
 		start_critical_timings();
 		local_irq_restore(flags);
+		if (current == printk_kthread && need_resched()) {
+			/*
+			 * Do not sit on console_sem while preempted: an
+			 * oops or panic must be able to take it and flush
+			 * the consoles itself.  Whoever got it meanwhile
+			 * prints the rest.
+			 */
+			console_locked = 0;
+			up(&console_sem);
+			cond_resched();
+			if (!console_trylock()) {
+				if (wake_klogd)
+					wake_up_klogd();
+				return;
+			}
+		}
 	}
 	console_locked = 0;
 
@@ -1604,6 +1916,7 @@ static int __init printk_late_init(void)
 		}
 	}
 	hotcpu_notifier(console_cpu_notify, 0);
+	printk_start_kthread();
 	return 0;
 }
 late_initcall(printk_late_init);
@@ -1725,6 +2038,7 @@ void kmsg_dump(enum kmsg_dump_reason reason)
 	   there's not a lot we can do about that. The new messages
 	   will overwrite the start of what we dump. */
 	spin_lock_irqsave(&logbuf_lock, flags);
+	printk_rb_drain();
 	end = log_end & LOG_BUF_MASK;
 	chars = logged_chars;
 	spin_unlock_irqrestore(&logbuf_lock, flags);
@@ -1089,6 +1089,7 @@ static void rcu_send_cbs_to_online(struct rcu_state *rsp)
 	struct rcu_data *rdp = this_cpu_ptr(rsp->rda);
 	struct rcu_data *receive_rdp = per_cpu_ptr(rsp->rda, receive_cpu);
 
+	rcu_nocb_take_back(rdp);
 	if (rdp->nxtlist == NULL)
 		return;  /* irqs disabled, so comparison is stable. */
 
@@ -1212,8 +1213,10 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 			rdp->nxttail[count] = &rdp->nxtlist;
 	local_irq_restore(flags);
 
-	/* Invoke callbacks. */
+	/* Invoke callbacks, or leave them all to this CPU's rcuo kthread. */
 	count = 0;
+	if (rcu_nocb_queue(rdp, list, tail))
+		list = NULL;
 	while (list) {
 		next = list->next;
 		prefetch(next);
@@ -1227,6 +1230,7 @@ static void rcu_do_batch(struct rcu_state *rsp, struct rcu_data *rdp)
 	local_irq_save(flags);
 
 	/* Update count, and requeue any remaining callbacks. */
+	count += rcu_nocb_taken(rdp);
 	rdp->qlen -= count;
 	rdp->n_cbs_invoked += count;
 	if (list != NULL) {
@@ -1848,6 +1852,7 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	rdp->dynticks = &per_cpu(rcu_dynticks, cpu);
 #endif /* #ifdef CONFIG_NO_HZ */
 	rdp->cpu = cpu;
+	rcu_boot_init_nocb_percpu_data(rdp);
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
 }
 
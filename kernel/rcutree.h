@@ -298,6 +298,18 @@ struct rcu_data {
 	unsigned long n_rp_need_fqs;
 	unsigned long n_rp_need_nothing;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+	/* 6) callbacks offloaded to the rcuo kthread. */
+	struct task_struct *nocb_kthread; /* NULL unless in rcu_nocbs=. */
+	struct rcu_head *nocb_head;	/* CBs waiting for the kthread. */
+	struct rcu_head **nocb_tail;
+	spinlock_t nocb_lock;		/* Protects nocb_head/nocb_tail. */
+	wait_queue_head_t nocb_wq;	/* For the kthread to sleep on. */
+	atomic_long_t nocb_taken;	/* CBs taken, still in ->qlen. */
+	unsigned long n_nocb_queued;	/* CBs taken by the kthread. */
+	unsigned long n_nocb_invoked;	/* CBs invoked by the kthread. */
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 	int cpu;
 };
 
@@ -466,5 +478,12 @@ static void rcu_yield(void (*f)(unsigned long), unsigned long arg);
 #endif /* #ifdef CONFIG_RCU_BOOST */
 static void rcu_cpu_kthread_setrt(int cpu, int to_rt);
 static void __cpuinit rcu_prepare_kthreads(int cpu);
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp);
+static bool rcu_nocb_queue(struct rcu_data *rdp, struct rcu_head *list,
+			   struct rcu_head **tail);
+static long rcu_nocb_taken(struct rcu_data *rdp);
+#ifdef CONFIG_HOTPLUG_CPU
+static void rcu_nocb_take_back(struct rcu_data *rdp);
+#endif /* #ifdef CONFIG_HOTPLUG_CPU */
 
 #endif /* #ifndef RCU_TREE_NONCORE */
@@ -2008,3 +2008,226 @@ static void rcu_needs_cpu_flush(void)
 }
 
 #endif /* #else #if !defined(CONFIG_RCU_FAST_NO_HZ) */
+
+#ifdef CONFIG_RCU_NOCB_CPU
+
+/*
+ * Offload the invocation of RCU callbacks from the CPUs listed in the
+ * rcu_nocbs= boot parameter.  Grace periods are still tracked from each
+ * CPU's RCU_SOFTIRQ as usual, but once a batch of callbacks is ready,
+ * rcu_do_batch() hands all of it to a per-CPU "rcuo" kthread instead of
+ * invoking it in place.  The kthreads start out affined to the CPUs not
+ * in rcu_nocbs=, and user space may move them wherever it likes.
+ */
+
+static cpumask_var_t rcu_nocb_mask;
+static bool have_rcu_nocb_mask;
+
+static int __init rcu_nocb_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&rcu_nocb_mask);
+	if (cpulist_parse(str, rcu_nocb_mask) < 0) {
+		printk(KERN_WARNING "RCU: Incorrect rcu_nocbs cpumask\n");
+		return 1;
+	}
+	have_rcu_nocb_mask = !cpumask_empty(rcu_nocb_mask);
+	return 1;
+}
+__setup("rcu_nocbs=", rcu_nocb_setup);
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+	rdp->nocb_head = NULL;
+	rdp->nocb_tail = &rdp->nocb_head;
+	atomic_long_set(&rdp->nocb_taken, 0);
+	spin_lock_init(&rdp->nocb_lock);
+	init_waitqueue_head(&rdp->nocb_wq);
+}
+
+/*
+ * Hand a list of callbacks whose grace period has ended to the CPU's
+ * rcuo kthread, if it has one.  Returns false if the caller is to
+ * invoke them itself.  The list is not counted here: the callbacks
+ * stay in ->qlen until the kthread has taken them, see rcu_nocb_taken().
+ */
+static bool rcu_nocb_queue(struct rcu_data *rdp, struct rcu_head *list,
+			   struct rcu_head **tail)
+{
+	unsigned long flags;
+
+	if (!ACCESS_ONCE(rdp->nocb_kthread))
+		return false;
+
+	spin_lock_irqsave(&rdp->nocb_lock, flags);
+	*rdp->nocb_tail = list;
+	rdp->nocb_tail = tail;
+	spin_unlock_irqrestore(&rdp->nocb_lock, flags);
+
+	wake_up(&rdp->nocb_wq);
+	return true;
+}
+
+/*
+ * Number of callbacks the rcuo kthread has taken since the last call,
+ * to be taken off ->qlen by the caller.  Called with irqs disabled.
+ */
+static long rcu_nocb_taken(struct rcu_data *rdp)
+{
+	if (!atomic_long_read(&rdp->nocb_taken))
+		return 0;
+	return atomic_long_xchg(&rdp->nocb_taken, 0);
+}
+
+#ifdef CONFIG_HOTPLUG_CPU
+/*
+ * The CPU is going offline: put the callbacks the rcuo kthread has not
+ * taken yet back at the head of ->nxtlist, as ready callbacks, so that
+ * they move to an online CPU together with ->qlen.  Called with irqs
+ * disabled, from stop_machine() context.
+ */
+static void rcu_nocb_take_back(struct rcu_data *rdp)
+{
+	struct rcu_head *list, **tail;
+	long count;
+	int i;
+
+	spin_lock(&rdp->nocb_lock);
+	list = rdp->nocb_head;
+	tail = rdp->nocb_tail;
+	rdp->nocb_head = NULL;
+	rdp->nocb_tail = &rdp->nocb_head;
+	count = rcu_nocb_taken(rdp);
+	spin_unlock(&rdp->nocb_lock);
+
+	rdp->qlen -= count;
+	rdp->n_cbs_invoked += count;
+
+	if (list == NULL)
+		return;
+	*tail = rdp->nxtlist;
+	rdp->nxtlist = list;
+	for (i = 0; i < RCU_NEXT_SIZE; i++)
+		if (&rdp->nxtlist == rdp->nxttail[i])
+			rdp->nxttail[i] = tail;
+		else
+			break;
+}
+#endif /* #ifdef CONFIG_HOTPLUG_CPU */
+
+/*
+ * Per-CPU callback-invocation kthread.  Callbacks are run in the order
+ * they were handed over, so rcu_barrier() still waits for everything
+ * queued before it, and with bottom halves disabled, as they expect.
+ */
+static int rcu_nocb_kthread(void *arg)
+{
+	struct rcu_data *rdp = arg;
+	struct rcu_head *list, *next;
+	long count;
+
+	for (;;) {
+		wait_event_interruptible(rdp->nocb_wq,
+					 ACCESS_ONCE(rdp->nocb_head));
+
+		/*
+		 * Count what we take under the lock, so that the CPU going
+		 * offline finds each callback either here or in ->nocb_head.
+		 */
+		spin_lock_irq(&rdp->nocb_lock);
+		list = rdp->nocb_head;
+		rdp->nocb_head = NULL;
+		rdp->nocb_tail = &rdp->nocb_head;
+		for (count = 0, next = list; next; next = next->next)
+			count++;
+		atomic_long_add(count, &rdp->nocb_taken);
+		rdp->n_nocb_queued += count;
+		spin_unlock_irq(&rdp->nocb_lock);
+
+		while (list) {
+			next = list->next;
+			prefetch(next);
+			debug_rcu_head_unqueue(list);
+			local_bh_disable();
+			__rcu_reclaim(list);
+			local_bh_enable();
+			rdp->n_nocb_invoked++;
+			list = next;
+			cond_resched();
+		}
+	}
+	return 0;
+}
+
+static void __init rcu_spawn_nocb_kthreads(struct rcu_state *rsp,
+					   const struct cpumask *affinity)
+{
+	int cpu;
+	struct rcu_data *rdp;
+	struct task_struct *t;
+
+	for_each_cpu_and(cpu, rcu_nocb_mask, cpu_possible_mask) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		t = kthread_create(rcu_nocb_kthread, rdp, "rcuo%c/%d",
+				   rsp->name[4], cpu);
+		if (IS_ERR(t)) {
+			printk(KERN_WARNING "RCU: Could not create rcuo%c/%d, "
+			       "callbacks stay on the CPU\n", rsp->name[4], cpu);
+			continue;
+		}
+		if (!cpumask_empty(affinity))
+			set_cpus_allowed_ptr(t, affinity);
+		wake_up_process(t);
+		ACCESS_ONCE(rdp->nocb_kthread) = t;
+	}
+}
+
+/*
+ * Spawn the rcuo kthreads -- called as soon as the scheduler is running.
+ * Until then, callbacks from rcu_nocbs= CPUs are invoked as usual.
+ */
+static int __init rcu_spawn_all_nocb_kthreads(void)
+{
+	cpumask_var_t affinity;
+	char buf[64];
+
+	if (!have_rcu_nocb_mask)
+		return 0;
+	if (!zalloc_cpumask_var(&affinity, GFP_KERNEL))
+		return 0;
+	cpumask_andnot(affinity, cpu_possible_mask, rcu_nocb_mask);
+	cpulist_scnprintf(buf, sizeof(buf), rcu_nocb_mask);
+	printk(KERN_INFO "RCU: Offloading callbacks from CPUs %s.\n", buf);
+	rcu_spawn_nocb_kthreads(&rcu_sched_state, affinity);
+	rcu_spawn_nocb_kthreads(&rcu_bh_state, affinity);
+#ifdef CONFIG_TREE_PREEMPT_RCU
+	rcu_spawn_nocb_kthreads(&rcu_preempt_state, affinity);
+#endif /* #ifdef CONFIG_TREE_PREEMPT_RCU */
+	free_cpumask_var(affinity);
+	return 0;
+}
+early_initcall(rcu_spawn_all_nocb_kthreads);
+
+#else /* #ifdef CONFIG_RCU_NOCB_CPU */
+
+static void __init rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp)
+{
+}
+
+static bool rcu_nocb_queue(struct rcu_data *rdp, struct rcu_head *list,
+			   struct rcu_head **tail)
+{
+	return false;
+}
+
+static long rcu_nocb_taken(struct rcu_data *rdp)
+{
+	return 0;
+}
+
+#ifdef CONFIG_HOTPLUG_CPU
+static void rcu_nocb_take_back(struct rcu_data *rdp)
+{
+}
+#endif /* #ifdef CONFIG_HOTPLUG_CPU */
+
+#endif /* #else #ifdef CONFIG_RCU_NOCB_CPU */
@@ -332,6 +332,14 @@ struct cfs_rq {
 	unsigned int nr_spread_over;
 #endif
 
+#ifdef CONFIG_SMP
+	/*
+	 * Sum of se->avg.load_avg_contrib of the entities queued here;
+	 * this is what load balancing sees instead of load.weight.
+	 */
+	unsigned long runnable_load_avg;
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	struct rq *rq;	/* cpu runqueue to which this cfs_rq is attached */
 
@@ -523,6 +531,9 @@ struct rq {
 	u64 age_stamp;
 	u64 idle_stamp;
 	u64 avg_idle;
+
+	/* exit latency (usecs) of the idle state the cpu is in, if any */
+	unsigned int idle_exit_latency;
 #endif
 
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
@@ -1509,7 +1520,7 @@ static int tg_nop(struct task_group *tg, void *data)
 /* Used instead of source_load when we know the type == 0 */
 static unsigned long weighted_cpuload(const int cpu)
 {
-	return cpu_rq(cpu)->load.weight;
+	return cpu_rq(cpu)->cfs.runnable_load_avg;
 }
 
 /*
@@ -1558,7 +1569,7 @@ static unsigned long cpu_avg_load_per_task(int cpu)
 	unsigned long nr_running = ACCESS_ONCE(rq->nr_running);
 
 	if (nr_running)
-		rq->avg_load_per_task = rq->load.weight / nr_running;
+		rq->avg_load_per_task = rq->cfs.runnable_load_avg / nr_running;
 	else
 		rq->avg_load_per_task = 0;
 
@@ -1578,11 +1589,11 @@ static int tg_load_down(struct task_group *tg, void *data)
 	long cpu = (long)data;
 
 	if (!tg->parent) {
-		load = cpu_rq(cpu)->load.weight;
+		load = cpu_rq(cpu)->cfs.runnable_load_avg;
 	} else {
 		load = tg->parent->cfs_rq[cpu]->h_load;
-		load *= tg->se[cpu]->load.weight;
-		load /= tg->parent->cfs_rq[cpu]->load.weight + 1;
+		load *= tg->se[cpu]->avg.load_avg_contrib;
+		load /= tg->parent->cfs_rq[cpu]->runnable_load_avg + 1;
 	}
 
 	tg->cfs_rq[cpu]->h_load = load;
@@ -1779,6 +1790,16 @@ static const struct sched_class rt_sched_class;
 static void inc_nr_running(struct rq *rq)
 {
 	rq->nr_running++;
+
+	/*
+	 * A full dynticks CPU may stop its tick while running a single
+	 * task. Always kick it when a second one arrives: testing whether
+	 * the tick is stopped would race with the CPU stopping it. On
+	 * irq_exit() it sees two tasks and keeps or restarts the tick,
+	 * the current task keeps running.
+	 */
+	if (rq->nr_running == 2 && tick_nohz_full_cpu(cpu_of(rq)))
+		smp_send_reschedule(cpu_of(rq));
 }
 
 static void dec_nr_running(struct rq *rq)
@@ -1786,6 +1807,17 @@ static void dec_nr_running(struct rq *rq)
 	rq->nr_running--;
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * The tick is only needed for preemption when there is more than one task
+ * to run on this CPU.
+ */
+bool sched_can_stop_tick(void)
+{
+	return this_rq()->nr_running <= 1;
+}
+#endif
+
 static void set_load_weight(struct task_struct *p)
 {
 	int prio = p->static_prio - MAX_RT_PRIO;
@@ -2576,7 +2608,11 @@ void scheduler_ipi(void)
 	struct rq *rq = this_rq();
 	struct task_struct *list = xchg(&rq->wake_list, NULL);
 
-	if (!list)
+	/*
+	 * Full dynticks CPUs get a reschedule IPI when they need their
+	 * tick back, see inc_nr_running(). irq_exit() restarts it.
+	 */
+	if (!list && !tick_nohz_full_cpu(smp_processor_id()))
 		return;
 
 	/*
@@ -2593,7 +2629,8 @@ void scheduler_ipi(void)
 	 * somewhat pessimize the simple resched case.
 	 */
 	irq_enter();
-	sched_ttwu_do_pending(list);
+	if (list)
+		sched_ttwu_do_pending(list);
 	irq_exit();
 }
 
@@ -2808,6 +2845,10 @@ static void __sched_fork(struct task_struct *p)
 	p->se.vruntime			= 0;
 	INIT_LIST_HEAD(&p->se.group_node);
 
+#ifdef CONFIG_SMP
+	memset(&p->se.avg, 0, sizeof(p->se.avg));
+#endif
+
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
@@ -3581,7 +3622,11 @@ decay_load_missed(unsigned long load, unsigned long missed_updates, int idx)
  */
 static void update_cpu_load(struct rq *this_rq)
 {
+#ifdef CONFIG_SMP
+	unsigned long this_load = this_rq->cfs.runnable_load_avg;
+#else
 	unsigned long this_load = this_rq->load.weight;
+#endif
 	unsigned long curr_jiffies = jiffies;
 	unsigned long pending_updates;
 	int i, scale;
@@ -4279,6 +4324,7 @@ need_resched:
 		rq->curr = next;
 		++*switch_count;
 
+		tick_nohz_task_switch_out(prev);
 		context_switch(rq, prev, next); /* unlocks the rq */
 		/*
 		 * The context switch have flipped the stack from under us
@@ -4293,6 +4339,8 @@ need_resched:
 
 	post_schedule(rq);
 
+	tick_nohz_task_switch();
+
 	preempt_enable_no_resched();
 	if (need_resched())
 		goto need_resched;
@@ -4997,6 +5045,20 @@ int idle_cpu(int cpu)
 	return cpu_curr(cpu) == cpu_rq(cpu)->idle;
 }
 
+#ifdef CONFIG_SMP
+/**
+ * sched_idle_set_exit_latency - note the idle state this cpu is entering
+ * @latency: exit latency of the state in usecs, 0 once the cpu is out of it
+ *
+ * Called by cpuidle around entering a C-state, so that wakeup placement
+ * can tell a cpu in a shallow state from one that is expensive to wake.
+ */
+void sched_idle_set_exit_latency(unsigned int latency)
+{
+	this_rq()->idle_exit_latency = latency;
+}
+#endif
+
 /**
  * idle_task - return the idle task for a given cpu.
  * @cpu: the processor in question.
@@ -862,6 +862,262 @@ static inline void update_entity_shares_tick(struct cfs_rq *cfs_rq)
 }
 #endif /* CONFIG_FAIR_GROUP_SCHED */
 
+#ifdef CONFIG_SMP
+/*
+ * Per-entity load tracking.
+ *
+ * Each sched_entity keeps a geometric series of the time it spent runnable,
+ * split into ~1ms (1024us) periods:
+ *
+ *   runnable_avg_sum = u_0 + u_1*y + u_2*y^2 + ...
+ *
+ * where u_i is the runnable time within the period i periods ago and y is
+ * chosen so that y^32 = 0.5, i.e. a period 32ms ago counts half as much as
+ * the current one.  runnable_avg_period is the same series with every
+ * period counted as fully runnable; the ratio of the two is the fraction
+ * of recent time the entity wanted the cpu.
+ *
+ * Scaled by the entity's weight that ratio becomes load_avg_contrib, and
+ * cfs_rq->runnable_load_avg is the sum of the contributions of the entities
+ * queued on it.  For a group entity the weight is its share of the group,
+ * so the contributions propagate up the hierarchy to rq->cfs, which is
+ * what the load balancer looks at.
+ */
+#define LOAD_AVG_PERIOD	32
+#define LOAD_AVG_MAX	47742	/* maximum possible load avg */
+#define LOAD_AVG_MAX_N	345	/* periods needed to reach LOAD_AVG_MAX */
+
+/* Precomputed fixed inverse multiplies for multiplication by y^n */
+static const u32 runnable_avg_yN_inv[] = {
+	0xffffffff, 0xfa83b2da, 0xf5257d14, 0xefe4b99a, 0xeac0c6e6, 0xe5b906e6,
+	0xe0ccdeeb, 0xdbfbb796, 0xd744fcc9, 0xd2a81d91, 0xce248c14, 0xc9b9bd85,
+	0xc5672a10, 0xc12c4cc9, 0xbd08a39e, 0xb8fbaf46, 0xb504f333, 0xb123f581,
+	0xad583ee9, 0xa9a15ab4, 0xa5fed6a9, 0xa2704302, 0x9ef5325f, 0x9b8d39b9,
+	0x9837f050, 0x94f4efa8, 0x91c3d373, 0x8ea4398a, 0x8b95c1e3, 0x88980e80,
+	0x85aac367, 0x82cd8698,
+};
+
+/*
+ * Precomputed \Sum y^k { 1<=k<=n }.  These are floor(true_value) to prevent
+ * over-estimates when re-combining.
+ */
+static const u32 runnable_avg_yN_sum[] = {
+	    0, 1002, 1982, 2941, 3879, 4797, 5696, 6575, 7436, 8278, 9102,
+	 9908,10697,11469,12225,12965,13689,14397,15090,15768,16432,17081,
+	17716,18338,18947,19543,20126,20696,21254,21800,22334,22857,23369,
+};
+
+/*
+ * Approximate val * y^n, where y^32 ~= 0.5 (~1 scheduling period).
+ */
+static __always_inline u64 decay_load(u64 val, u64 n)
+{
+	unsigned int local_n;
+
+	if (!n)
+		return val;
+	else if (unlikely(n > LOAD_AVG_PERIOD * 63))
+		return 0;
+
+	/* after bounds checking we can collapse to 32-bit */
+	local_n = n;
+
+	/*
+	 * As y^PERIOD = 1/2, we can combine
+	 *    y^n = 1/2^(n/PERIOD) * y^(n%PERIOD)
+	 * with a look-up table which covers y^n (n<PERIOD)
+	 */
+	if (unlikely(local_n >= LOAD_AVG_PERIOD)) {
+		val >>= local_n / LOAD_AVG_PERIOD;
+		local_n %= LOAD_AVG_PERIOD;
+	}
+
+	val *= runnable_avg_yN_inv[local_n];
+	/* val fits in 32 bits here, so the product fits in 64 */
+	return val >> 32;
+}
+
+/*
+ * For updates fully spanning n periods, the contribution to runnable
+ * average will be: \Sum 1024*y^n
+ *
+ * We can compute this reasonably efficiently by combining:
+ *   y^PERIOD = 1/2 with precomputed \Sum 1024*y^n {for  n <PERIOD}
+ */
+static u32 __compute_runnable_contrib(u64 n)
+{
+	u32 contrib = 0;
+
+	if (likely(n <= LOAD_AVG_PERIOD))
+		return runnable_avg_yN_sum[n];
+	else if (unlikely(n >= LOAD_AVG_MAX_N))
+		return LOAD_AVG_MAX;
+
+	/* Compute \Sum k^n combining precomputed values for k^i, \Sum k^j */
+	do {
+		contrib /= 2; /* y^LOAD_AVG_PERIOD = 1/2 */
+		contrib += runnable_avg_yN_sum[LOAD_AVG_PERIOD];
+
+		n -= LOAD_AVG_PERIOD;
+	} while (n > LOAD_AVG_PERIOD);
+
+	contrib = decay_load(contrib, n);
+	return contrib + runnable_avg_yN_sum[n];
+}
+
+/*
+ * Fold the time since the last update into sa.  Time is accounted in
+ * 1024ns units; a partially elapsed period is carried in the low bits of
+ * runnable_avg_period and only decayed once the period completes.
+ *
+ * Returns non-zero when at least one period boundary was crossed, i.e.
+ * when the average actually changed enough to be worth propagating.
+ */
+static __always_inline int __update_entity_runnable_avg(u64 now,
+							struct sched_avg *sa,
+							int runnable)
+{
+	u64 delta, periods;
+	u32 runnable_contrib;
+	int delta_w, decayed = 0;
+
+	delta = now - sa->last_runnable_update;
+	/*
+	 * This should only happen when time goes backwards, which it
+	 * unfortunately can when an entity moves to a cpu whose clock_task
+	 * lags the one it came from.  Just resynchronize.
+	 */
+	if ((s64)delta < 0) {
+		sa->last_runnable_update = now;
+		return 0;
+	}
+
+	/* Use 1024ns as the unit of measurement since it's a reasonable
+	 * approximation of 1us and fast to compute. */
+	delta >>= 10;
+	if (!delta)
+		return 0;
+	sa->last_runnable_update += delta << 10;
+
+	/* delta_w is the amount already accumulated against our next period */
+	delta_w = sa->runnable_avg_period % 1024;
+	if (delta + delta_w >= 1024) {
+		/* period roll-over */
+		decayed = 1;
+
+		/*
+		 * Now that we know we're crossing a period boundary, figure
+		 * out how much from delta we need to complete the current
+		 * period and accrue it.
+		 */
+		delta_w = 1024 - delta_w;
+		if (runnable)
+			sa->runnable_avg_sum += delta_w;
+		sa->runnable_avg_period += delta_w;
+
+		delta -= delta_w;
+
+		/* Figure out how many additional periods this update spans */
+		periods = delta / 1024;
+		delta %= 1024;
+
+		sa->runnable_avg_sum = decay_load(sa->runnable_avg_sum,
+						  periods + 1);
+		sa->runnable_avg_period = decay_load(sa->runnable_avg_period,
+						     periods + 1);
+
+		/* Efficiently calculate \sum (1..n_period) 1024*y^i */
+		runnable_contrib = __compute_runnable_contrib(periods);
+		if (runnable)
+			sa->runnable_avg_sum += runnable_contrib;
+		sa->runnable_avg_period += runnable_contrib;
+	}
+
+	/* Remainder of delta accrued against u_0 */
+	if (runnable)
+		sa->runnable_avg_sum += delta;
+	sa->runnable_avg_period += delta;
+
+	return decayed;
+}
+
+/* Compute the current contribution to load_avg by se, return any delta */
+static long __update_entity_load_avg_contrib(struct sched_entity *se)
+{
+	long old_contrib = se->avg.load_avg_contrib;
+	u64 contrib;
+
+	contrib = (u64)se->avg.runnable_avg_sum * se->load.weight;
+	se->avg.load_avg_contrib = div_u64(contrib,
+					   se->avg.runnable_avg_period + 1);
+
+	return se->avg.load_avg_contrib - old_contrib;
+}
+
+/* Update a sched_entity's runnable average */
+static inline void update_entity_load_avg(struct sched_entity *se,
+					  int update_cfs_rq)
+{
+	struct cfs_rq *cfs_rq = cfs_rq_of(se);
+	long contrib_delta;
+
+	if (!__update_entity_runnable_avg(rq_of(cfs_rq)->clock_task, &se->avg,
+					  se->on_rq))
+		return;
+
+	contrib_delta = __update_entity_load_avg_contrib(se);
+	if (update_cfs_rq)
+		cfs_rq->runnable_load_avg += contrib_delta;
+}
+
+/*
+ * Add the entity's contribution to the cfs_rq it is being queued on.  The
+ * time since a wakeup is folded in as non-runnable; any other enqueue
+ * (migration, reweighting, class change) has no real gap, so the clock is
+ * just resynchronized to the new runqueue.
+ */
+static inline void enqueue_entity_load_avg(struct cfs_rq *cfs_rq,
+					   struct sched_entity *se,
+					   int wakeup)
+{
+	if (wakeup)
+		update_entity_load_avg(se, 0);
+	else
+		se->avg.last_runnable_update = rq_of(cfs_rq)->clock_task;
+
+	__update_entity_load_avg_contrib(se);
+	cfs_rq->runnable_load_avg += se->avg.load_avg_contrib;
+}
+
+/* Remove the entity's contribution from the cfs_rq it is leaving */
+static inline void dequeue_entity_load_avg(struct cfs_rq *cfs_rq,
+					   struct sched_entity *se)
+{
+	update_entity_load_avg(se, 1);
+	cfs_rq->runnable_load_avg -= min(cfs_rq->runnable_load_avg,
+					 se->avg.load_avg_contrib);
+}
+
+static void task_fork_load_avg(struct sched_entity *se)
+{
+	/*
+	 * A new task has no history; start it out as fully runnable so it
+	 * is not undervalued by the balancer until it has run for a while.
+	 */
+	se->avg.runnable_avg_sum = LOAD_AVG_MAX;
+	se->avg.runnable_avg_period = LOAD_AVG_MAX;
+}
+#else
+static inline void update_entity_load_avg(struct sched_entity *se,
+					  int update_cfs_rq) {}
+static inline void enqueue_entity_load_avg(struct cfs_rq *cfs_rq,
+					   struct sched_entity *se,
+					   int wakeup) {}
+static inline void dequeue_entity_load_avg(struct cfs_rq *cfs_rq,
+					   struct sched_entity *se) {}
+static inline void task_fork_load_avg(struct sched_entity *se) {}
+#endif
+
 static void enqueue_sleeper(struct cfs_rq *cfs_rq, struct sched_entity *se)
 {
 #ifdef CONFIG_SCHEDSTATS
@@ -984,6 +1240,7 @@ enqueue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 	 */
 	update_curr(cfs_rq);
 	update_cfs_load(cfs_rq, 0);
+	enqueue_entity_load_avg(cfs_rq, se, flags & ENQUEUE_WAKEUP);
 	account_entity_enqueue(cfs_rq, se);
 	update_cfs_shares(cfs_rq);
 
@@ -1073,6 +1330,7 @@ dequeue_entity(struct cfs_rq *cfs_rq, struct sched_entity *se, int flags)
 
 	if (se != cfs_rq->curr)
 		__dequeue_entity(cfs_rq, se);
+	dequeue_entity_load_avg(cfs_rq, se);
 	se->on_rq = 0;
 	update_cfs_load(cfs_rq, 0);
 	account_entity_dequeue(cfs_rq, se);
@@ -1144,6 +1402,8 @@ set_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
 		 */
 		update_stats_wait_end(cfs_rq, se);
 		__dequeue_entity(cfs_rq, se);
+		/* account the time spent waiting as runnable */
+		update_entity_load_avg(se, 1);
 	}
 
 	update_stats_curr_start(cfs_rq, se);
@@ -1218,6 +1478,7 @@ static void put_prev_entity(struct cfs_rq *cfs_rq, struct sched_entity *prev)
 		update_stats_wait_start(cfs_rq, prev);
 		/* Put 'current' back into the tree. */
 		__enqueue_entity(cfs_rq, prev);
+		update_entity_load_avg(prev, 1);
 	}
 	cfs_rq->curr = NULL;
 }
@@ -1230,6 +1491,11 @@ entity_tick(struct cfs_rq *cfs_rq, struct sched_entity *curr, int queued)
 	 */
 	update_curr(cfs_rq);
 
+	/*
+	 * Keep the running entity's load average up to date.
+	 */
+	update_entity_load_avg(curr, 1);
+
 	/*
 	 * Update share accounting for long-running entities.
 	 */
@@ -1484,14 +1750,14 @@ static int wake_affine(struct sched_domain *sd, struct task_struct *p, int sync)
 	rcu_read_lock();
 	if (sync) {
 		tg = task_group(current);
-		weight = current->se.load.weight;
+		weight = current->se.avg.load_avg_contrib;
 
 		this_load += effective_load(tg, this_cpu, -weight, -weight);
 		load += effective_load(tg, prev_cpu, 0, -weight);
 	}
 
 	tg = task_group(p);
-	weight = p->se.load.weight;
+	weight = p->se.avg.load_avg_contrib;
 
 	/*
 	 * In low-load situations, where prev_cpu is idle and this_cpu is idle
@@ -1623,6 +1889,15 @@ find_idlest_cpu(struct sched_group *group, struct task_struct *p, int this_cpu)
 	return idlest;
 }
 
+/*
+ * Exit latency of the idle state @cpu is sitting in, as reported by
+ * cpuidle; 0 if it is polling or not idle at all.
+ */
+static inline unsigned int idle_exit_latency(int cpu)
+{
+	return ACCESS_ONCE(cpu_rq(cpu)->idle_exit_latency);
+}
+
 /*
  * Try and locate an idle CPU in the sched_domain.
  */
@@ -1630,8 +1905,9 @@ static int select_idle_sibling(struct task_struct *p, int target)
 {
 	int cpu = smp_processor_id();
 	int prev_cpu = task_cpu(p);
+	unsigned int latency, min_latency = UINT_MAX;
 	struct sched_domain *sd;
-	int i;
+	int i, shallowest = -1;
 
 	/*
 	 * If the task is going to be woken-up on this cpu and if it is
@@ -1642,11 +1918,23 @@ static int select_idle_sibling(struct task_struct *p, int target)
 
 	/*
 	 * If the task is going to be woken-up on the cpu where it previously
-	 * ran and if it is currently idle, then it the right target.
+	 * ran and if it is currently idle, then it the right target -- unless
+	 * it went into a deep C-state and a sibling would wake up faster.
 	 */
-	if (target == prev_cpu && idle_cpu(prev_cpu))
+	if (target == prev_cpu && idle_cpu(prev_cpu) &&
+	    (!sched_feat(IDLE_EXIT_LATENCY) || !idle_exit_latency(prev_cpu)))
 		return prev_cpu;
 
+	/*
+	 * A sibling only beats the cache hot prev_cpu if it is strictly
+	 * cheaper to wake.
+	 */
+	if (target == prev_cpu && idle_cpu(prev_cpu) &&
+	    sched_feat(IDLE_EXIT_LATENCY)) {
+		min_latency = idle_exit_latency(prev_cpu);
+		shallowest = prev_cpu;
+	}
+
 	/*
 	 * Otherwise, iterate the domains and find an elegible idle cpu.
 	 */
@@ -1656,10 +1944,22 @@ static int select_idle_sibling(struct task_struct *p, int target)
 			break;
 
 		for_each_cpu_and(i, sched_domain_span(sd), &p->cpus_allowed) {
-			if (idle_cpu(i)) {
+			if (!idle_cpu(i))
+				continue;
+
+			if (!sched_feat(IDLE_EXIT_LATENCY)) {
 				target = i;
 				break;
 			}
+
+			/* prefer the idle cpu that is cheapest to wake */
+			latency = idle_exit_latency(i);
+			if (latency < min_latency) {
+				min_latency = latency;
+				shallowest = i;
+				if (!latency)
+					break;
+			}
 		}
 
 		/*
@@ -1672,6 +1972,9 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	}
 	rcu_read_unlock();
 
+	if (shallowest >= 0)
+		target = shallowest;
+
 	return target;
 }
 
@@ -2156,14 +2459,14 @@ balance_tasks(struct rq *this_rq, int this_cpu, struct rq *busiest,
 		if (loops++ > sysctl_sched_nr_migrate)
 			break;
 
-		if ((p->se.load.weight >> 1) > rem_load_move ||
+		if ((p->se.avg.load_avg_contrib >> 1) > rem_load_move ||
 		    !can_migrate_task(p, busiest, this_cpu, sd, idle,
 				      all_pinned))
 			continue;
 
 		pull_task(busiest, p, this_rq, this_cpu);
 		pulled++;
-		rem_load_move -= p->se.load.weight;
+		rem_load_move -= p->se.avg.load_avg_contrib;
 
 #ifdef CONFIG_PREEMPT
 		/*
@@ -2252,7 +2555,7 @@ load_balance_fair(struct rq *this_rq, int this_cpu, struct rq *busiest,
 	list_for_each_entry_rcu(tg, &task_groups, list) {
 		struct cfs_rq *busiest_cfs_rq = tg->cfs_rq[busiest_cpu];
 		unsigned long busiest_h_load = busiest_cfs_rq->h_load;
-		unsigned long busiest_weight = busiest_cfs_rq->load.weight;
+		unsigned long busiest_weight = busiest_cfs_rq->runnable_load_avg;
 		u64 rem_load, moved_load;
 
 		/*
@@ -4150,6 +4453,7 @@ static void task_fork_fair(struct task_struct *p)
 	if (curr)
 		se->vruntime = curr->vruntime;
 	place_entity(cfs_rq, se, 1);
+	task_fork_load_avg(se);
 
 	if (sysctl_sched_child_runs_first && curr && entity_before(curr, se)) {
 		/*
@@ -71,4 +71,10 @@ SCHED_FEAT(NONIRQ_POWER, 1)
  */
 SCHED_FEAT(TTWU_QUEUE, 1)
 
+/*
+ * When waking a task onto an idle sibling, prefer the one whose cpuidle
+ * state has the lowest exit latency rather than the first one found.
+ */
+SCHED_FEAT(IDLE_EXIT_LATENCY, 1)
+
 SCHED_FEAT(FORCE_SD_OVERLAP, 0)
@@ -61,6 +61,98 @@ char *softirq_to_name[NR_SOFTIRQS] = {
 	"TASKLET", "SCHED", "HRTIMER", "RCU"
 };
 
+/*
+ * Threaded softirqs: with "threadsoftirqs" on the command line every
+ * softirq vector is run by its own per-cpu kthread, sirq-<name>/<cpu>,
+ * instead of on interrupt exit or from ksoftirqd.  Being ordinary tasks
+ * the threads can be given a scheduling policy and priority of their
+ * own, either at boot with "softirq_prio=" or later with chrt, so that
+ * e.g. NET_RX can be placed below a latency sensitive application and
+ * TIMER above it.
+ *
+ * Pending vectors are moved from the irq_stat pending mask over to
+ * softirq_thread_pending, with interrupts disabled, and the matching
+ * threads are woken.  Until a cpu's threads are up (early boot, cpu
+ * bringup) softirqs are processed the traditional way.
+ */
+static bool softirq_threaded __read_mostly;
+
+static char *softirq_thread_name[NR_SOFTIRQS] = {
+	"hi", "timer", "net-tx", "net-rx", "block", "iopoll",
+	"tasklet", "sched", "hrtimer", "rcu"
+};
+
+/* Priority the threads are created with, 0 means SCHED_NORMAL */
+static int softirq_thread_prio[NR_SOFTIRQS];
+
+static DEFINE_PER_CPU(struct task_struct *, softirq_thread[NR_SOFTIRQS]);
+static DEFINE_PER_CPU(__u32, softirq_thread_pending);
+static DEFINE_PER_CPU(bool, softirq_threads_running);
+
+static int __init setup_threaded_softirqs(char *arg)
+{
+	softirq_threaded = true;
+	return 0;
+}
+early_param("threadsoftirqs", setup_threaded_softirqs);
+
+/*
+ * softirq_prio=<vector>:<prio>[,<vector>:<prio>...]
+ * e.g. softirq_prio=TIMER:60,NET_RX:10
+ */
+static int __init setup_softirq_prio(char *str)
+{
+	char *tok, *name;
+	int nr, prio;
+
+	while ((tok = strsep(&str, ",")) != NULL) {
+		name = strsep(&tok, ":");
+		if (!tok || kstrtoint(tok, 0, &prio) ||
+		    prio < 0 || prio >= MAX_USER_RT_PRIO)
+			goto bad;
+		for (nr = 0; nr < NR_SOFTIRQS; nr++)
+			if (!strcmp(name, softirq_to_name[nr]))
+				break;
+		if (nr == NR_SOFTIRQS)
+			goto bad;
+		softirq_thread_prio[nr] = prio;
+	}
+	return 0;
+bad:
+	printk(KERN_WARNING "softirq_prio: bad entry '%s'\n", name);
+	return 0;
+}
+early_param("softirq_prio", setup_softirq_prio);
+
+/*
+ * Hand the pending softirqs over to their threads.  Must be called
+ * with interrupts disabled.  Returns false if the threads are not
+ * running on this cpu and the caller has to process them itself.
+ */
+static bool wakeup_softirq_threads(void)
+{
+	__u32 pending;
+	int nr;
+
+	if (!softirq_threaded || !__this_cpu_read(softirq_threads_running))
+		return false;
+
+	pending = local_softirq_pending();
+	set_softirq_pending(0);
+	__this_cpu_or(softirq_thread_pending, pending);
+
+	for (nr = 0; pending; nr++, pending >>= 1) {
+		struct task_struct *tsk;
+
+		if (!(pending & 1))
+			continue;
+		tsk = __this_cpu_read(softirq_thread[nr]);
+		if (tsk->state != TASK_RUNNING)
+			wake_up_process(tsk);
+	}
+	return true;
+}
+
 /*
  * we cannot loop indefinitely here to avoid userspace starvation,
  * but we also don't want to introduce a worst case 1/HZ latency
@@ -72,6 +164,9 @@ static void wakeup_softirqd(void)
 	/* Interrupts are disabled: no need to stop preemption */
 	struct task_struct *tsk = __this_cpu_read(ksoftirqd);
 
+	if (wakeup_softirq_threads())
+		return;
+
 	if (tsk && tsk->state != TASK_RUNNING)
 		wake_up_process(tsk);
 }
@@ -211,6 +306,9 @@ asmlinkage void __do_softirq(void)
 	int max_restart = MAX_SOFTIRQ_RESTART;
 	int cpu;
 
+	if (wakeup_softirq_threads())
+		return;
+
 	pending = local_softirq_pending();
 	account_system_vtime(current);
 
@@ -352,6 +450,8 @@ void irq_exit(void)
 	/* Make sure that timer wheel updates are propagated */
 	if (idle_cpu(smp_processor_id()) && !in_interrupt() && !need_resched())
 		tick_nohz_stop_sched_tick(0);
+	else if (!in_interrupt())
+		tick_nohz_full_check();
 #endif
 	preempt_enable_no_resched();
 }
@@ -784,7 +884,151 @@ wait_to_die:
 	return 0;
 }
 
+static int run_softirq_thread(void *data)
+{
+	unsigned int nr = (unsigned long)data;
+	struct softirq_action *h = &softirq_vec[nr];
+	__u32 mask = 1 << nr;
+	/* Only ever started once bound, see create_softirq_threads() */
+	int cpu = raw_smp_processor_id();
+
+	set_current_state(TASK_INTERRUPTIBLE);
+
+	while (!kthread_should_stop()) {
+		preempt_disable();
+		if (!(__this_cpu_read(softirq_thread_pending) & mask)) {
+			preempt_enable_no_resched();
+			schedule();
+			preempt_disable();
+		}
+
+		__set_current_state(TASK_RUNNING);
+
+		while (__this_cpu_read(softirq_thread_pending) & mask) {
+			int prev_count;
+
+			/* See run_ksoftirqd() */
+			if (cpu_is_offline(cpu))
+				goto wait_to_die;
+
+			local_irq_disable();
+			__this_cpu_and(softirq_thread_pending, ~mask);
+			account_system_vtime(current);
+			__local_bh_disable((unsigned long)__builtin_return_address(0),
+					   SOFTIRQ_OFFSET);
+			lockdep_softirq_enter();
+			local_irq_enable();
+
+			prev_count = preempt_count();
+			kstat_incr_softirqs_this_cpu(nr);
+
+			trace_softirq_entry(nr);
+			h->action(h);
+			trace_softirq_exit(nr);
+			if (unlikely(prev_count != preempt_count())) {
+				printk(KERN_ERR "huh, entered softirq %u %s %p"
+				       "with preempt_count %08x,"
+				       " exited with %08x?\n", nr,
+				       softirq_to_name[nr], h->action,
+				       prev_count, preempt_count());
+				preempt_count() = prev_count;
+			}
+			rcu_bh_qs(cpu);
+
+			local_irq_disable();
+			lockdep_softirq_exit();
+			account_system_vtime(current);
+			__local_bh_enable(SOFTIRQ_OFFSET);
+			/* Softirqs raised by the handler itself */
+			if (local_softirq_pending())
+				wakeup_softirq_threads();
+			local_irq_enable();
+
+			preempt_enable_no_resched();
+			cond_resched();
+			preempt_disable();
+			rcu_note_context_switch(cpu);
+		}
+		preempt_enable();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+
+wait_to_die:
+	preempt_enable();
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+static int __cpuinit create_softirq_threads(int cpu)
+{
+	struct task_struct *p;
+	int nr;
+
+	for (nr = 0; nr < NR_SOFTIRQS; nr++) {
+		if (per_cpu(softirq_thread[nr], cpu))
+			continue;
+		p = kthread_create_on_node(run_softirq_thread,
+					   (void *)(unsigned long)nr,
+					   cpu_to_node(cpu), "sirq-%s/%d",
+					   softirq_thread_name[nr], cpu);
+		if (IS_ERR(p)) {
+			printk("sirq-%s for %i failed\n",
+			       softirq_thread_name[nr], cpu);
+			return PTR_ERR(p);
+		}
+		if (softirq_thread_prio[nr]) {
+			struct sched_param param = {
+				.sched_priority = softirq_thread_prio[nr]
+			};
+
+			sched_setscheduler_nocheck(p, SCHED_FIFO, &param);
+		}
+		kthread_bind(p, cpu);
+		per_cpu(softirq_thread[nr], cpu) = p;
+	}
+	return 0;
+}
+
+static void __cpuinit start_softirq_threads(int cpu)
+{
+	int nr;
+
+	for (nr = 0; nr < NR_SOFTIRQS; nr++)
+		wake_up_process(per_cpu(softirq_thread[nr], cpu));
+	per_cpu(softirq_threads_running, cpu) = true;
+}
+
 #ifdef CONFIG_HOTPLUG_CPU
+static void stop_softirq_threads(int cpu, bool unbind)
+{
+	static const struct sched_param param = {
+		.sched_priority = MAX_RT_PRIO-1
+	};
+	struct task_struct *p;
+	int nr;
+
+	per_cpu(softirq_threads_running, cpu) = false;
+	for (nr = 0; nr < NR_SOFTIRQS; nr++) {
+		p = per_cpu(softirq_thread[nr], cpu);
+		if (!p)
+			continue;
+		per_cpu(softirq_thread[nr], cpu) = NULL;
+		if (unbind)
+			kthread_bind(p, cpumask_any(cpu_online_mask));
+		sched_setscheduler_nocheck(p, SCHED_FIFO, &param);
+		kthread_stop(p);
+	}
+	/* Whatever the threads did not get to is lost, like irq_stat's */
+	per_cpu(softirq_thread_pending, cpu) = 0;
+}
+
 /*
  * tasklet_kill_immediate is called to remove a tasklet which can already be
  * scheduled for execution on @cpu.
@@ -863,14 +1107,24 @@ static int __cpuinit cpu_callback(struct notifier_block *nfb,
 		}
 		kthread_bind(p, hotcpu);
   		per_cpu(ksoftirqd, hotcpu) = p;
+		if (softirq_threaded) {
+			int err = create_softirq_threads(hotcpu);
+
+			if (err)
+				return notifier_from_errno(err);
+		}
  		break;
 	case CPU_ONLINE:
 	case CPU_ONLINE_FROZEN:
 		wake_up_process(per_cpu(ksoftirqd, hotcpu));
+		if (softirq_threaded)
+			start_softirq_threads(hotcpu);
 		break;
 #ifdef CONFIG_HOTPLUG_CPU
 	case CPU_UP_CANCELED:
 	case CPU_UP_CANCELED_FROZEN:
+		if (softirq_threaded)
+			stop_softirq_threads(hotcpu, true);
 		if (!per_cpu(ksoftirqd, hotcpu))
 			break;
 		/* Unbind so it can run.  Fall thru. */
@@ -882,6 +1136,8 @@ static int __cpuinit cpu_callback(struct notifier_block *nfb,
 			.sched_priority = MAX_RT_PRIO-1
 		};
 
+		if (softirq_threaded)
+			stop_softirq_threads(hotcpu, false);
 		p = per_cpu(ksoftirqd, hotcpu);
 		per_cpu(ksoftirqd, hotcpu) = NULL;
 		sched_setscheduler_nocheck(p, SCHED_FIFO, &param);
@@ -17,6 +17,7 @@
 #include <linux/interrupt.h>
 #include <linux/kernel_stat.h>
 #include <linux/percpu.h>
+#include <linux/posix-timers.h>
 #include <linux/profile.h>
 #include <linux/sched.h>
 #include <linux/module.h>
@@ -98,6 +99,38 @@ static ktime_t tick_init_jiffy_update(void)
 	return period;
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Nobody accounts the time of a busy CPU while its tick is stopped. Charge
+ * the jiffies that went by to @p, the task that ran through them, except
+ * for the one the tick handler is about to account if @ticking.
+ */
+static void tick_nohz_full_catch_up(struct tick_sched *ts,
+				    struct task_struct *p, int user_tick,
+				    int ticking)
+{
+	unsigned long ticks;
+
+	if (!ts->tick_stopped || ts->inidle)
+		return;
+
+	ticks = jiffies - ts->full_jiffies;
+	ts->full_jiffies += ticks;
+	/*
+	 * We might be one off. Do not randomly account a huge number of ticks!
+	 */
+	if (!ticks || ticks >= LONG_MAX)
+		return;
+	ticks -= ticking;
+	while (ticks--)
+		account_process_tick(p, user_tick);
+}
+#else
+static inline void tick_nohz_full_catch_up(struct tick_sched *ts,
+					   struct task_struct *p,
+					   int user_tick, int ticking) { }
+#endif
+
 /*
  * NOHZ - aka dynamic tick functionality
  */
@@ -123,6 +156,37 @@ static int __init setup_tick_nohz(char *str)
 
 __setup("nohz=", setup_tick_nohz);
 
+#ifdef CONFIG_NO_HZ_FULL
+cpumask_var_t tick_nohz_full_mask;
+bool tick_nohz_full_running;
+
+/*
+ * CPUs which may stop their tick while busy. The boot CPU is not one of
+ * them: it starts out with the jiffies update duty and somebody has to
+ * keep it.
+ */
+static int __init tick_nohz_full_setup(char *str)
+{
+	int cpu = smp_processor_id();
+
+	alloc_bootmem_cpumask_var(&tick_nohz_full_mask);
+	if (cpulist_parse(str, tick_nohz_full_mask) < 0) {
+		printk(KERN_WARNING "NOHZ: Incorrect nohz_full cpumask\n");
+		return 1;
+	}
+
+	if (cpumask_test_cpu(cpu, tick_nohz_full_mask)) {
+		printk(KERN_WARNING "NOHZ: Clearing %d from nohz_full range "
+		       "for timekeeping\n", cpu);
+		cpumask_clear_cpu(cpu, tick_nohz_full_mask);
+	}
+	tick_nohz_full_running = !cpumask_empty(tick_nohz_full_mask);
+	return 1;
+}
+
+__setup("nohz_full=", tick_nohz_full_setup);
+#endif
+
 /**
  * tick_nohz_update_jiffies - update jiffies when idle was interrupted
  *
@@ -303,6 +367,20 @@ void tick_nohz_stop_sched_tick(int inidle)
 	if (need_resched())
 		goto end;
 
+#ifdef CONFIG_NO_HZ_FULL
+	/*
+	 * The full dynticks CPUs rely on a housekeeping CPU to update
+	 * jiffies, so the one which has that duty keeps its tick.
+	 */
+	if (tick_nohz_full_running) {
+		if (tick_do_timer_cpu == TICK_DO_TIMER_NONE &&
+		    !tick_nohz_full_cpu(cpu))
+			tick_do_timer_cpu = cpu;
+		if (cpu == tick_do_timer_cpu)
+			goto end;
+	}
+#endif
+
 	if (unlikely(local_softirq_pending() && cpu_online(cpu))) {
 		static int ratelimit;
 
@@ -552,6 +630,158 @@ void tick_nohz_restart_sched_tick(void)
 	local_irq_enable();
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+static bool can_stop_full_tick(int cpu, struct tick_sched *ts)
+{
+	if (unlikely(ts->nohz_mode == NOHZ_MODE_INACTIVE))
+		return false;
+
+	if (cpu == tick_do_timer_cpu)
+		return false;
+
+	if (!sched_can_stop_tick())
+		return false;
+
+	if (!posix_cpu_timers_can_stop_tick(current))
+		return false;
+
+	if (local_softirq_pending())
+		return false;
+
+	if (rcu_needs_cpu(cpu) || printk_needs_cpu(cpu) ||
+	    arch_needs_cpu(cpu))
+		return false;
+
+	return true;
+}
+
+/*
+ * Program the tick for the next timer event, but at least once a second:
+ * that residual tick keeps the scheduler statistics and the load
+ * accounting of the running task going. Returns false if the tick could
+ * not be stopped.
+ */
+static bool tick_nohz_full_stop_tick(struct tick_sched *ts)
+{
+	unsigned long seq, last_jiffies, delta_jiffies;
+	ktime_t last_update, expires;
+
+	do {
+		seq = read_seqbegin(&xtime_lock);
+		last_update = last_jiffies_update;
+		last_jiffies = jiffies;
+	} while (read_seqretry(&xtime_lock, seq));
+
+	delta_jiffies = get_next_timer_interrupt(last_jiffies) - last_jiffies;
+	if ((long)delta_jiffies <= 1)
+		return false;
+	if (delta_jiffies > HZ)
+		delta_jiffies = HZ;
+
+	expires = ktime_add_ns(last_update, tick_period.tv64 * delta_jiffies);
+
+	/* Skip reprogram of event if its not changed */
+	if (ts->tick_stopped &&
+	    ktime_equal(expires, hrtimer_get_expires(&ts->sched_timer)))
+		return true;
+
+	if (!ts->tick_stopped) {
+		ts->idle_tick = hrtimer_get_expires(&ts->sched_timer);
+		ts->tick_stopped = 1;
+		ts->full_jiffies = last_jiffies;
+		ts->full_stops++;
+	}
+
+	if (ts->nohz_mode == NOHZ_MODE_HIGHRES) {
+		hrtimer_start(&ts->sched_timer, expires,
+			      HRTIMER_MODE_ABS_PINNED);
+		/* Check, if the timer was already in the past */
+		return hrtimer_active(&ts->sched_timer);
+	}
+
+	hrtimer_set_expires(&ts->sched_timer, expires);
+	return !tick_program_event(expires, 0);
+}
+
+static void tick_nohz_full_update(int user_tick)
+{
+	int cpu = smp_processor_id();
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+
+	if (!tick_nohz_full_cpu(cpu) || ts->inidle)
+		return;
+
+	/*
+	 * The idle task stops the tick itself, together with the idle
+	 * accounting and RCU bits that go with it.
+	 */
+	if (!idle_cpu(cpu) && can_stop_full_tick(cpu, ts) &&
+	    tick_nohz_full_stop_tick(ts))
+		return;
+
+	if (ts->tick_stopped) {
+		tick_nohz_full_catch_up(ts, current, user_tick, 0);
+		ts->tick_stopped = 0;
+		tick_nohz_restart(ts, ktime_get());
+	}
+}
+
+/**
+ * __tick_nohz_full_check - stop or restart the tick of a busy CPU
+ *
+ * Called from irq_exit() on the nohz_full CPUs, which includes the
+ * reschedule IPI sent to them when they get a second runnable task.
+ */
+void __tick_nohz_full_check(void)
+{
+	int cpu = smp_processor_id();
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+	struct pt_regs *regs = get_irq_regs();
+	int user_tick = regs ? user_mode(regs) : 0;
+	unsigned long flags;
+
+	local_irq_save(flags);
+	/*
+	 * Without the tick nobody reports this CPU's quiescent states to
+	 * RCU. RCU sends a reschedule IPI to the CPUs holding up a grace
+	 * period, so doing it on interrupts is enough.
+	 */
+	if (tick_nohz_full_cpu(cpu) && ts->tick_stopped && !ts->inidle)
+		rcu_check_callbacks(cpu, user_tick);
+	tick_nohz_full_update(user_tick);
+	local_irq_restore(flags);
+}
+
+/**
+ * __tick_nohz_task_switch_out - account a stopped tick to the outgoing task
+ * @prev: the task being switched out
+ *
+ * Called by the scheduler with interrupts disabled, before the context
+ * switch: the ticks missed so far belong to @prev and not to whatever
+ * runs when the tick is restarted.
+ */
+void __tick_nohz_task_switch_out(struct task_struct *prev)
+{
+	int cpu = smp_processor_id();
+	struct tick_sched *ts = &per_cpu(tick_cpu_sched, cpu);
+
+	if (tick_nohz_full_cpu(cpu))
+		tick_nohz_full_catch_up(ts, prev, 0, 0);
+}
+
+/**
+ * __tick_nohz_task_switch - reevaluate the tick after a context switch
+ */
+void __tick_nohz_task_switch(void)
+{
+	unsigned long flags;
+
+	local_irq_save(flags);
+	tick_nohz_full_update(0);
+	local_irq_restore(flags);
+}
+#endif
+
 static int tick_nohz_reprogram(struct tick_sched *ts, ktime_t now)
 {
 	hrtimer_forward(&ts->sched_timer, now, tick_period);
@@ -577,7 +807,8 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 	 * this duty, then the jiffies update is still serialized by
 	 * xtime_lock.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 
 	/* Check, if the jiffies need an update */
@@ -597,6 +828,7 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 		ts->idle_jiffies++;
 	}
 
+	tick_nohz_full_catch_up(ts, current, user_mode(regs), 1);
 	update_process_times(user_mode(regs));
 	profile_tick(CPU_PROFILING);
 
@@ -731,7 +963,8 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 	 * this duty, then the jiffies update is still serialized by
 	 * xtime_lock.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 #endif
 
@@ -756,6 +989,7 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 			touch_softlockup_watchdog();
 			ts->idle_jiffies++;
 		}
+		tick_nohz_full_catch_up(ts, current, user_mode(regs), 1);
 		update_process_times(user_mode(regs));
 		profile_tick(CPU_PROFILING);
 	}
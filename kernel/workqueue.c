@@ -18,7 +18,9 @@
  * executed in process context.  The worker pool is shared and
  * automatically managed.  There is one worker pool for each CPU and
  * one extra for works which are better served by workers which are
- * not bound to any specific CPU.
+ * not bound to any specific CPU.  Unbound workqueues can be moved to
+ * a few more pools whose workers are confined to a cpumask and run at
+ * a given nice level.
  *
  * Please read Documentation/workqueue.txt for details.
  */
@@ -41,6 +43,8 @@
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
 #include <linux/idr.h>
+#include <linux/device.h>
+#include <linux/seqlock.h>
 
 #include "workqueue_sched.h"
 
@@ -112,6 +116,8 @@ enum {
  * F: wq->flush_mutex protected.
  *
  * W: workqueue_lock protected.
+ *
+ * M: wq_pool_mutex protected.
  */
 
 struct global_cwq;
@@ -137,6 +143,7 @@ struct worker {
 	unsigned int		flags;		/* X: flags */
 	int			id;		/* I: worker id */
 	struct work_struct	rebind_work;	/* L: rebind worker to cpu */
+	unsigned int		attrs_seq;	/* gcwq attrs last applied */
 };
 
 /*
@@ -167,6 +174,11 @@ struct global_cwq {
 	unsigned int		trustee_state;	/* L: trustee state */
 	wait_queue_head_t	trustee_wait;	/* trustee wait */
 	struct worker		*first_idle;	/* L: first idle worker */
+
+	/* unbound attribute pools only, see get_unbound_pool() */
+	struct workqueue_attrs	*attrs;		/* M: worker attributes */
+	int			attrs_refcnt;	/* M: wqs using the pool */
+	seqcount_t		attrs_seq;	/* M: attrs update sequence */
 } ____cacheline_aligned_in_smp;
 
 /*
@@ -242,6 +254,9 @@ struct workqueue_struct {
 
 	int			saved_max_active; /* W: saved cwq max_active */
 	const char		*name;		/* I: workqueue name */
+#ifdef CONFIG_SYSFS
+	struct wq_device	*wq_dev;	/* I: for sysfs interface */
+#endif
 #ifdef CONFIG_LOCKDEP
 	struct lockdep_map	lockdep_map;
 #endif
@@ -278,7 +293,8 @@ static inline int __next_gcwq_cpu(int cpu, const struct cpumask *mask,
 		}
 		if (sw & 2)
 			return WORK_CPU_UNBOUND;
-	}
+	} else if (sw & 4 && cpu + 1 < WORK_CPU_NONE)
+		return cpu + 1;
 	return WORK_CPU_NONE;
 }
 
@@ -293,24 +309,29 @@ static inline int __next_wq_cpu(int cpu, const struct cpumask *mask,
  *
  * An extra gcwq is defined for an invalid cpu number
  * (WORK_CPU_UNBOUND) to host workqueues which are not bound to any
- * specific CPU.  The following iterators are similar to
- * for_each_*_cpu() iterators but also considers the unbound gcwq.
+ * specific CPU, followed by WORK_NR_UNBOUND_POOLS - 1 attribute pools
+ * for unbound workqueues with non-default attributes.  The following
+ * iterators are similar to for_each_*_cpu() iterators but also
+ * considers the unbound gcwqs.
  *
- * for_each_gcwq_cpu()		: possible CPUs + WORK_CPU_UNBOUND
+ * for_each_gcwq_cpu()		: possible CPUs + all unbound gcwqs
  * for_each_online_gcwq_cpu()	: online CPUs + WORK_CPU_UNBOUND
  * for_each_cwq_cpu()		: possible CPUs for bound workqueues,
  *				  WORK_CPU_UNBOUND for unbound workqueues
  */
 #define for_each_gcwq_cpu(cpu)						\
-	for ((cpu) = __next_gcwq_cpu(-1, cpu_possible_mask, 3);		\
+	for ((cpu) = __next_gcwq_cpu(-1, cpu_possible_mask, 7);		\
 	     (cpu) < WORK_CPU_NONE;					\
-	     (cpu) = __next_gcwq_cpu((cpu), cpu_possible_mask, 3))
+	     (cpu) = __next_gcwq_cpu((cpu), cpu_possible_mask, 7))
 
 #define for_each_online_gcwq_cpu(cpu)					\
 	for ((cpu) = __next_gcwq_cpu(-1, cpu_online_mask, 3);		\
 	     (cpu) < WORK_CPU_NONE;					\
 	     (cpu) = __next_gcwq_cpu((cpu), cpu_online_mask, 3))
 
+#define for_each_unbound_pool(cpu)					\
+	for ((cpu) = WORK_CPU_UNBOUND + 1; (cpu) < WORK_CPU_NONE; (cpu)++)
+
 #define for_each_cwq_cpu(cpu, wq)					\
 	for ((cpu) = __next_wq_cpu(-1, cpu_possible_mask, (wq));	\
 	     (cpu) < WORK_CPU_NONE;					\
@@ -437,6 +458,9 @@ static DEFINE_SPINLOCK(workqueue_lock);
 static LIST_HEAD(workqueues);
 static bool workqueue_freezing;		/* W: have wqs started freezing? */
 
+/* Serializes unbound pool attributes and moving workqueues between pools. */
+static DEFINE_MUTEX(wq_pool_mutex);
+
 /*
  * The almighty global cpu workqueues.  nr_running is the only field
  * which is expected to be used frequently by other cpus via
@@ -446,31 +470,42 @@ static DEFINE_PER_CPU(struct global_cwq, global_cwq);
 static DEFINE_PER_CPU_SHARED_ALIGNED(atomic_t, gcwq_nr_running);
 
 /*
- * Global cpu workqueue and nr_running counter for unbound gcwq.  The
- * gcwq is always online, has GCWQ_DISASSOCIATED set, and all its
- * workers have WORKER_UNBOUND set.
+ * Global cpu workqueues and nr_running counter for unbound gcwqs.  The
+ * gcwqs are always online, have GCWQ_DISASSOCIATED set, and all their
+ * workers have WORKER_UNBOUND set.  The first one serves unbound
+ * workqueues with default attributes, the others are handed out by
+ * get_unbound_pool().
  */
-static struct global_cwq unbound_global_cwq;
+static struct global_cwq unbound_global_cwq[WORK_NR_UNBOUND_POOLS];
 static atomic_t unbound_gcwq_nr_running = ATOMIC_INIT(0);	/* always 0 */
 
 static int worker_thread(void *__worker);
 
+static bool gcwq_is_unbound(struct global_cwq *gcwq)
+{
+	return gcwq->cpu >= WORK_CPU_UNBOUND;
+}
+
 static struct global_cwq *get_gcwq(unsigned int cpu)
 {
-	if (cpu != WORK_CPU_UNBOUND)
+	if (cpu < WORK_CPU_UNBOUND)
 		return &per_cpu(global_cwq, cpu);
 	else
-		return &unbound_global_cwq;
+		return &unbound_global_cwq[cpu - WORK_CPU_UNBOUND];
 }
 
 static atomic_t *get_gcwq_nr_running(unsigned int cpu)
 {
-	if (cpu != WORK_CPU_UNBOUND)
+	if (cpu < WORK_CPU_UNBOUND)
 		return &per_cpu(gcwq_nr_running, cpu);
 	else
 		return &unbound_gcwq_nr_running;
 }
 
+/*
+ * An unbound workqueue has a single cwq, which is returned for any of
+ * the unbound gcwq IDs; cwq->gcwq tells which pool currently serves it.
+ */
 static struct cpu_workqueue_struct *get_cwq(unsigned int cpu,
 					    struct workqueue_struct *wq)
 {
@@ -482,7 +517,7 @@ static struct cpu_workqueue_struct *get_cwq(unsigned int cpu,
 			return wq->cpu_wq.single;
 #endif
 		}
-	} else if (likely(cpu == WORK_CPU_UNBOUND))
+	} else if (likely(cpu >= WORK_CPU_UNBOUND && cpu < WORK_CPU_NONE))
 		return wq->cpu_wq.single;
 	return NULL;
 }
@@ -565,7 +600,7 @@ static struct global_cwq *get_work_gcwq(struct work_struct *work)
 	if (cpu == WORK_CPU_NONE)
 		return NULL;
 
-	BUG_ON(cpu >= nr_cpu_ids && cpu != WORK_CPU_UNBOUND);
+	BUG_ON(cpu >= nr_cpu_ids && cpu < WORK_CPU_UNBOUND);
 	return get_gcwq(cpu);
 }
 
@@ -1027,13 +1062,25 @@ static void __queue_work(unsigned int cpu, struct workqueue_struct *wq,
 			}
 		} else
 			spin_lock_irqsave(&gcwq->lock, flags);
+
+		cwq = get_cwq(gcwq->cpu, wq);
 	} else {
-		gcwq = get_gcwq(WORK_CPU_UNBOUND);
-		spin_lock_irqsave(&gcwq->lock, flags);
+		/*
+		 * The cwq may be moved to another pool by
+		 * apply_workqueue_attrs(), which does so with the old
+		 * gcwq->lock held.  Recheck after locking.
+		 */
+		cwq = get_cwq(WORK_CPU_UNBOUND, wq);
+		for (;;) {
+			gcwq = ACCESS_ONCE(cwq->gcwq);
+			spin_lock_irqsave(&gcwq->lock, flags);
+			if (likely(cwq->gcwq == gcwq))
+				break;
+			spin_unlock_irqrestore(&gcwq->lock, flags);
+		}
 	}
 
-	/* gcwq determined, get cwq and queue */
-	cwq = get_cwq(gcwq->cpu, wq);
+	/* gcwq and cwq determined, queue */
 	trace_workqueue_queue_work(cpu, cwq, work);
 
 	BUG_ON(!list_empty(&work->entry));
@@ -1158,7 +1205,7 @@ int queue_delayed_work_on(int cpu, struct workqueue_struct *wq,
 		if (!(wq->flags & WQ_UNBOUND)) {
 			struct global_cwq *gcwq = get_work_gcwq(work);
 
-			if (gcwq && gcwq->cpu != WORK_CPU_UNBOUND)
+			if (gcwq && !gcwq_is_unbound(gcwq))
 				lcpu = gcwq->cpu;
 			else
 				lcpu = raw_smp_processor_id();
@@ -1358,7 +1405,7 @@ static struct worker *alloc_worker(void)
  */
 static struct worker *create_worker(struct global_cwq *gcwq, bool bind)
 {
-	bool on_unbound_cpu = gcwq->cpu == WORK_CPU_UNBOUND;
+	bool on_unbound_cpu = gcwq_is_unbound(gcwq);
 	struct worker *worker = NULL;
 	int id = -1;
 
@@ -1383,9 +1430,13 @@ static struct worker *create_worker(struct global_cwq *gcwq, bool bind)
 						      worker,
 						      cpu_to_node(gcwq->cpu),
 						      "kworker/%u:%d", gcwq->cpu, id);
-	else
+	else if (gcwq->cpu == WORK_CPU_UNBOUND)
 		worker->task = kthread_create(worker_thread, worker,
 					      "kworker/u:%d", id);
+	else
+		worker->task = kthread_create(worker_thread, worker,
+					      "kworker/u%u:%d",
+					      gcwq->cpu - WORK_CPU_UNBOUND, id);
 	if (IS_ERR(worker->task))
 		goto fail;
 
@@ -1502,8 +1553,8 @@ static bool send_mayday(struct work_struct *work)
 
 	/* mayday mayday mayday */
 	cpu = cwq->gcwq->cpu;
-	/* WORK_CPU_UNBOUND can't be set in cpumask, use cpu 0 instead */
-	if (cpu == WORK_CPU_UNBOUND)
+	/* unbound gcwqs can't be set in cpumask, use cpu 0 instead */
+	if (cpu >= WORK_CPU_UNBOUND)
 		cpu = 0;
 	if (!mayday_test_and_set_cpu(cpu, wq->mayday_mask))
 		wake_up_process(wq->rescuer->task);
@@ -1927,6 +1978,36 @@ static void process_scheduled_works(struct worker *worker)
 	}
 }
 
+/**
+ * worker_apply_attrs - pick up the attributes of an unbound pool
+ * @worker: self
+ *
+ * Workers of an attribute pool set their own affinity and nice level,
+ * as PF_THREAD_BOUND keeps anybody else from changing the former.  The
+ * attributes change only while the pool is unused, so idle workers left
+ * over from a previous user catch up the next time they wake up.
+ *
+ * CONTEXT:
+ * Might sleep.  Called without gcwq->lock.
+ */
+static void worker_apply_attrs(struct worker *worker)
+{
+	struct global_cwq *gcwq = worker->gcwq;
+	unsigned int seq;
+
+	for (;;) {
+		seq = read_seqcount_begin(&gcwq->attrs_seq);
+		if (seq == worker->attrs_seq)
+			return;
+
+		set_cpus_allowed_ptr(current, gcwq->attrs->cpumask);
+		set_user_nice(current, gcwq->attrs->nice);
+
+		if (!read_seqcount_retry(&gcwq->attrs_seq, seq))
+			worker->attrs_seq = seq;
+	}
+}
+
 /**
  * worker_thread - the worker thread function
  * @__worker: self
@@ -1945,6 +2026,9 @@ static int worker_thread(void *__worker)
 	/* tell the scheduler that this is a workqueue worker */
 	worker->task->flags |= PF_WQ_WORKER;
 woke_up:
+	if (unlikely(gcwq->attrs))
+		worker_apply_attrs(worker);
+
 	spin_lock_irq(&gcwq->lock);
 
 	/* DIE can be set only while we're idle, checking here is enough */
@@ -2911,6 +2995,478 @@ static int wq_clamp_max_active(int max_active, unsigned int flags,
 	return clamp_val(max_active, 1, lim);
 }
 
+/**
+ * alloc_workqueue_attrs - allocate a workqueue_attrs
+ * @gfp_mask: allocation mask to use
+ *
+ * Allocate a new workqueue_attrs, initialized with the default
+ * attributes: nice 0 and all possible CPUs.
+ *
+ * RETURNS:
+ * The allocated workqueue_attrs on success, %NULL on failure.
+ */
+struct workqueue_attrs *alloc_workqueue_attrs(gfp_t gfp_mask)
+{
+	struct workqueue_attrs *attrs;
+
+	attrs = kzalloc(sizeof(*attrs), gfp_mask);
+	if (!attrs)
+		return NULL;
+	if (!alloc_cpumask_var(&attrs->cpumask, gfp_mask)) {
+		kfree(attrs);
+		return NULL;
+	}
+	cpumask_copy(attrs->cpumask, cpu_possible_mask);
+	return attrs;
+}
+EXPORT_SYMBOL_GPL(alloc_workqueue_attrs);
+
+/**
+ * free_workqueue_attrs - free a workqueue_attrs
+ * @attrs: workqueue_attrs to free, may be %NULL
+ */
+void free_workqueue_attrs(struct workqueue_attrs *attrs)
+{
+	if (attrs) {
+		free_cpumask_var(attrs->cpumask);
+		kfree(attrs);
+	}
+}
+EXPORT_SYMBOL_GPL(free_workqueue_attrs);
+
+static bool wqattrs_equal(const struct workqueue_attrs *a,
+			  const struct workqueue_attrs *b)
+{
+	return a->nice == b->nice && cpumask_equal(a->cpumask, b->cpumask);
+}
+
+static bool wqattrs_default(const struct workqueue_attrs *attrs)
+{
+	return !attrs->nice && cpumask_equal(attrs->cpumask, cpu_possible_mask);
+}
+
+/**
+ * get_unbound_pool - find or set up the unbound gcwq for @attrs
+ * @attrs: attributes the workers should run with
+ *
+ * Default attributes map to the unbound gcwq.  Other combinations
+ * share an attribute pool; if none matches, a pool no workqueue is
+ * using is taken over and given @attrs.  A reference is taken on the
+ * returned pool, drop it with put_unbound_pool().
+ *
+ * CONTEXT:
+ * Must be called with wq_pool_mutex held.  Might sleep.
+ *
+ * RETURNS:
+ * The gcwq on success, ERR_PTR() value on failure.
+ */
+static struct global_cwq *get_unbound_pool(const struct workqueue_attrs *attrs)
+{
+	struct global_cwq *gcwq, *free = NULL;
+	struct worker *worker;
+	unsigned int cpu;
+	int nr_workers;
+
+	if (wqattrs_default(attrs))
+		return get_gcwq(WORK_CPU_UNBOUND);
+
+	for_each_unbound_pool(cpu) {
+		gcwq = get_gcwq(cpu);
+		if (gcwq->attrs && wqattrs_equal(gcwq->attrs, attrs))
+			goto found;
+		if (!free && !gcwq->attrs_refcnt)
+			free = gcwq;
+	}
+
+	if (!free)
+		return ERR_PTR(-EBUSY);
+	gcwq = free;
+
+	if (!gcwq->attrs) {
+		gcwq->attrs = alloc_workqueue_attrs(GFP_KERNEL);
+		if (!gcwq->attrs)
+			return ERR_PTR(-ENOMEM);
+	}
+
+	preempt_disable();
+	write_seqcount_begin(&gcwq->attrs_seq);
+	gcwq->attrs->nice = attrs->nice;
+	cpumask_copy(gcwq->attrs->cpumask, attrs->cpumask);
+	write_seqcount_end(&gcwq->attrs_seq);
+	preempt_enable();
+found:
+	/* a pool never used before has no workers yet, give it one */
+	spin_lock_irq(&gcwq->lock);
+	nr_workers = gcwq->nr_workers;
+	spin_unlock_irq(&gcwq->lock);
+
+	if (!nr_workers) {
+		worker = create_worker(gcwq, true);
+		if (!worker)
+			return ERR_PTR(-ENOMEM);
+		spin_lock_irq(&gcwq->lock);
+		start_worker(worker);
+		spin_unlock_irq(&gcwq->lock);
+	}
+
+	gcwq->attrs_refcnt++;
+	return gcwq;
+}
+
+/* Drop a reference taken by get_unbound_pool().  wq_pool_mutex held. */
+static void put_unbound_pool(struct global_cwq *gcwq)
+{
+	if (gcwq->cpu != WORK_CPU_UNBOUND)
+		WARN_ON_ONCE(--gcwq->attrs_refcnt < 0);
+}
+
+/* Is nothing queued on, running from or delayed on @cwq?  gcwq->lock held. */
+static bool cwq_idle(struct cpu_workqueue_struct *cwq)
+{
+	int i;
+
+	for (i = 0; i < WORK_NR_COLORS; i++)
+		if (cwq->nr_in_flight[i])
+			return false;
+	return true;
+}
+
+/**
+ * apply_workqueue_attrs - move an unbound workqueue to another worker pool
+ * @wq: the target workqueue
+ * @attrs: attributes the workers serving @wq should run with
+ *
+ * Make the works of unbound @wq execute on workers which are confined
+ * to @attrs->cpumask and run at @attrs->nice.  @wq is flushed until it
+ * is found idle and then switched over; works queued after that go to
+ * the new pool.
+ *
+ * CONTEXT:
+ * Might sleep.  Must not be called from a work item on @wq.
+ *
+ * RETURNS:
+ * 0 on success, -EINVAL if @wq is per-cpu or @attrs are invalid, -EBUSY
+ * if all attribute pools are in use or @wq never went idle, -ENOMEM on
+ * allocation failure.
+ */
+int apply_workqueue_attrs(struct workqueue_struct *wq,
+			  const struct workqueue_attrs *attrs)
+{
+	struct cpu_workqueue_struct *cwq;
+	struct global_cwq *gcwq, *old;
+	int tries = 0, ret = 0;
+	bool moved;
+
+	if (!(wq->flags & WQ_UNBOUND))
+		return -EINVAL;
+	if (attrs->nice < -20 || attrs->nice > 19 ||
+	    !cpumask_intersects(attrs->cpumask, cpu_online_mask))
+		return -EINVAL;
+
+	mutex_lock(&wq_pool_mutex);
+	gcwq = get_unbound_pool(attrs);
+	mutex_unlock(&wq_pool_mutex);
+	if (IS_ERR(gcwq))
+		return PTR_ERR(gcwq);
+
+	cwq = get_cwq(WORK_CPU_UNBOUND, wq);
+
+	/*
+	 * Flushing may wait for works that take wq_pool_mutex, e.g. through
+	 * sysfs, so only hold it to look at and switch cwq->gcwq.  It is
+	 * rechecked each time, another caller may have moved @wq meanwhile.
+	 */
+	for (;;) {
+		mutex_lock(&wq_pool_mutex);
+		old = cwq->gcwq;
+		moved = old == gcwq;
+		if (!moved) {
+			/*
+			 * flush_mutex keeps flushers from coloring the cwq
+			 * and workqueue_lock keeps freezing and max_active
+			 * updates away while cwq->gcwq changes.  Queueing
+			 * rechecks cwq->gcwq after grabbing the old
+			 * gcwq->lock.
+			 */
+			mutex_lock(&wq->flush_mutex);
+			spin_lock(&workqueue_lock);
+			spin_lock_irq(&old->lock);
+
+			moved = cwq_idle(cwq);
+			if (moved)
+				cwq->gcwq = gcwq;
+
+			spin_unlock_irq(&old->lock);
+			spin_unlock(&workqueue_lock);
+			mutex_unlock(&wq->flush_mutex);
+		}
+
+		if (moved || ++tries == 10) {
+			if (!moved)
+				ret = -EBUSY;
+			/* drop the reference of the pool @wq no longer uses */
+			put_unbound_pool(moved ? old : gcwq);
+			mutex_unlock(&wq_pool_mutex);
+			return ret;
+		}
+		mutex_unlock(&wq_pool_mutex);
+
+		flush_workqueue(wq);
+	}
+}
+EXPORT_SYMBOL_GPL(apply_workqueue_attrs);
+
+#ifdef CONFIG_SYSFS
+/*
+ * Workqueues created with WQ_SYSFS appear under /sys/bus/workqueue.
+ * Unbound ones can be moved to an attribute pool by writing their
+ * "nice" and "cpumask" files, e.g. to keep heavy background work on
+ * housekeeping cpus.
+ */
+struct wq_device {
+	struct workqueue_struct		*wq;
+	struct device			dev;
+};
+
+static struct workqueue_struct *dev_to_wq(struct device *dev)
+{
+	return container_of(dev, struct wq_device, dev)->wq;
+}
+
+static ssize_t wq_per_cpu_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", !(wq->flags & WQ_UNBOUND));
+}
+
+static ssize_t wq_max_active_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", wq->saved_max_active);
+}
+
+static ssize_t wq_max_active_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	int val;
+
+	if (sscanf(buf, "%d", &val) != 1 || val <= 0)
+		return -EINVAL;
+
+	workqueue_set_max_active(wq, val);
+	return count;
+}
+
+static struct device_attribute wq_sysfs_attrs[] = {
+	__ATTR(per_cpu, 0444, wq_per_cpu_show, NULL),
+	__ATTR(max_active, 0644, wq_max_active_show, wq_max_active_store),
+	__ATTR_NULL,
+};
+
+/* the pool serving unbound @wq, stable under wq_pool_mutex */
+static struct global_cwq *wq_unbound_gcwq(struct workqueue_struct *wq)
+{
+	return get_cwq(WORK_CPU_UNBOUND, wq)->gcwq;
+}
+
+static ssize_t wq_pool_show(struct device *dev,
+			    struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	int written;
+
+	mutex_lock(&wq_pool_mutex);
+	written = scnprintf(buf, PAGE_SIZE, "%u\n",
+			    wq_unbound_gcwq(wq)->cpu - WORK_CPU_UNBOUND);
+	mutex_unlock(&wq_pool_mutex);
+
+	return written;
+}
+
+static ssize_t wq_nice_show(struct device *dev,
+			    struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	struct global_cwq *gcwq;
+	int written;
+
+	mutex_lock(&wq_pool_mutex);
+	gcwq = wq_unbound_gcwq(wq);
+	written = scnprintf(buf, PAGE_SIZE, "%d\n",
+			    gcwq->attrs ? gcwq->attrs->nice : 0);
+	mutex_unlock(&wq_pool_mutex);
+
+	return written;
+}
+
+static ssize_t wq_cpumask_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	struct global_cwq *gcwq;
+	int written;
+
+	mutex_lock(&wq_pool_mutex);
+	gcwq = wq_unbound_gcwq(wq);
+	written = cpumask_scnprintf(buf, PAGE_SIZE, gcwq->attrs ?
+				    gcwq->attrs->cpumask : cpu_possible_mask);
+	mutex_unlock(&wq_pool_mutex);
+
+	written += scnprintf(buf + written, PAGE_SIZE - written, "\n");
+	return written;
+}
+
+/* copy of the attributes @wq currently runs with */
+static struct workqueue_attrs *wq_sysfs_prep_attrs(struct workqueue_struct *wq)
+{
+	struct workqueue_attrs *attrs;
+	struct global_cwq *gcwq;
+
+	attrs = alloc_workqueue_attrs(GFP_KERNEL);
+	if (!attrs)
+		return NULL;
+
+	mutex_lock(&wq_pool_mutex);
+	gcwq = wq_unbound_gcwq(wq);
+	if (gcwq->attrs) {
+		attrs->nice = gcwq->attrs->nice;
+		cpumask_copy(attrs->cpumask, gcwq->attrs->cpumask);
+	}
+	mutex_unlock(&wq_pool_mutex);
+
+	return attrs;
+}
+
+static ssize_t wq_nice_store(struct device *dev,
+			     struct device_attribute *attr,
+			     const char *buf, size_t count)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	struct workqueue_attrs *attrs;
+	int ret;
+
+	attrs = wq_sysfs_prep_attrs(wq);
+	if (!attrs)
+		return -ENOMEM;
+
+	if (sscanf(buf, "%d", &attrs->nice) == 1)
+		ret = apply_workqueue_attrs(wq, attrs);
+	else
+		ret = -EINVAL;
+
+	free_workqueue_attrs(attrs);
+	return ret ?: count;
+}
+
+static ssize_t wq_cpumask_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct workqueue_struct *wq = dev_to_wq(dev);
+	struct workqueue_attrs *attrs;
+	int ret;
+
+	attrs = wq_sysfs_prep_attrs(wq);
+	if (!attrs)
+		return -ENOMEM;
+
+	ret = bitmap_parse(buf, count, cpumask_bits(attrs->cpumask),
+			   nr_cpumask_bits);
+	if (!ret)
+		ret = apply_workqueue_attrs(wq, attrs);
+
+	free_workqueue_attrs(attrs);
+	return ret ?: count;
+}
+
+static struct device_attribute wq_sysfs_unbound_attrs[] = {
+	__ATTR(pool, 0444, wq_pool_show, NULL),
+	__ATTR(nice, 0644, wq_nice_show, wq_nice_store),
+	__ATTR(cpumask, 0644, wq_cpumask_show, wq_cpumask_store),
+	__ATTR_NULL,
+};
+
+static struct bus_type wq_subsys = {
+	.name		= "workqueue",
+	.dev_attrs	= wq_sysfs_attrs,
+};
+
+static struct device *wq_sysfs_root;	/* M: set once the bus is up */
+
+static void wq_device_release(struct device *dev)
+{
+	kfree(container_of(dev, struct wq_device, dev));
+}
+
+/**
+ * wq_sysfs_register - make a workqueue visible in sysfs
+ * @wq: the workqueue to register
+ *
+ * Workqueues allocated with WQ_SYSFS before the workqueue bus is
+ * registered are picked up by wq_sysfs_init().
+ *
+ * CONTEXT:
+ * Must be called with wq_pool_mutex held.  Might sleep.
+ *
+ * RETURNS:
+ * 0 on success, -errno on failure.
+ */
+static int wq_sysfs_register(struct workqueue_struct *wq)
+{
+	struct device_attribute *attr;
+	struct wq_device *wq_dev;
+	int ret;
+
+	if (!wq_sysfs_root || wq->wq_dev)
+		return 0;
+
+	wq_dev = kzalloc(sizeof(*wq_dev), GFP_KERNEL);
+	if (!wq_dev)
+		return -ENOMEM;
+
+	wq_dev->wq = wq;
+	wq_dev->dev.bus = &wq_subsys;
+	wq_dev->dev.parent = wq_sysfs_root;
+	wq_dev->dev.release = wq_device_release;
+	dev_set_name(&wq_dev->dev, "%s", wq->name);
+
+	ret = device_register(&wq_dev->dev);
+	if (ret) {
+		put_device(&wq_dev->dev);
+		return ret;
+	}
+
+	if (wq->flags & WQ_UNBOUND) {
+		for (attr = wq_sysfs_unbound_attrs; attr->attr.name; attr++) {
+			ret = device_create_file(&wq_dev->dev, attr);
+			if (ret) {
+				device_unregister(&wq_dev->dev);
+				return ret;
+			}
+		}
+	}
+
+	wq->wq_dev = wq_dev;
+	return 0;
+}
+
+static void wq_sysfs_unregister(struct workqueue_struct *wq)
+{
+	if (wq->wq_dev)
+		device_unregister(&wq->wq_dev->dev);
+	wq->wq_dev = NULL;
+}
+#else
+static inline int wq_sysfs_register(struct workqueue_struct *wq) { return 0; }
+static inline void wq_sysfs_unregister(struct workqueue_struct *wq) { }
+#endif
+
 struct workqueue_struct *__alloc_workqueue_key(const char *name,
 					       unsigned int flags,
 					       int max_active,
@@ -3000,6 +3556,19 @@ struct workqueue_struct *__alloc_workqueue_key(const char *name,
 
 	spin_unlock(&workqueue_lock);
 
+	if (flags & WQ_SYSFS) {
+		int ret;
+
+		mutex_lock(&wq_pool_mutex);
+		ret = wq_sysfs_register(wq);
+		mutex_unlock(&wq_pool_mutex);
+
+		if (ret) {
+			destroy_workqueue(wq);
+			return NULL;
+		}
+	}
+
 	return wq;
 err:
 	if (wq) {
@@ -3023,6 +3592,9 @@ void destroy_workqueue(struct workqueue_struct *wq)
 	unsigned int flush_cnt = 0;
 	unsigned int cpu;
 
+	/* no more attribute changes from userland */
+	wq_sysfs_unregister(wq);
+
 	/*
 	 * Mark @wq dying and drain all pending works.  Once WQ_DYING is
 	 * set, only chain queueing is allowed.  IOW, only currently
@@ -3079,6 +3651,12 @@ reflush:
 		kfree(wq->rescuer);
 	}
 
+	if (wq->flags & WQ_UNBOUND) {
+		mutex_lock(&wq_pool_mutex);
+		put_unbound_pool(get_cwq(WORK_CPU_UNBOUND, wq)->gcwq);
+		mutex_unlock(&wq_pool_mutex);
+	}
+
 	free_cwqs(wq);
 	kfree(wq);
 }
@@ -3105,13 +3683,14 @@ void workqueue_set_max_active(struct workqueue_struct *wq, int max_active)
 	wq->saved_max_active = max_active;
 
 	for_each_cwq_cpu(cpu, wq) {
-		struct global_cwq *gcwq = get_gcwq(cpu);
+		struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
+		struct global_cwq *gcwq = cwq->gcwq;
 
 		spin_lock_irq(&gcwq->lock);
 
 		if (!(wq->flags & WQ_FREEZABLE) ||
 		    !(gcwq->flags & GCWQ_FREEZING))
-			get_cwq(gcwq->cpu, wq)->max_active = max_active;
+			cwq->max_active = max_active;
 
 		spin_unlock_irq(&gcwq->lock);
 	}
@@ -3674,7 +4253,8 @@ void freeze_workqueues_begin(void)
 		list_for_each_entry(wq, &workqueues, list) {
 			struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
 
-			if (cwq && wq->flags & WQ_FREEZABLE)
+			if (cwq && cwq->gcwq == gcwq &&
+			    wq->flags & WQ_FREEZABLE)
 				cwq->max_active = 0;
 		}
 
@@ -3707,6 +4287,7 @@ bool freeze_workqueues_busy(void)
 	BUG_ON(!workqueue_freezing);
 
 	for_each_gcwq_cpu(cpu) {
+		struct global_cwq *gcwq = get_gcwq(cpu);
 		struct workqueue_struct *wq;
 		/*
 		 * nr_active is monotonically decreasing.  It's safe
@@ -3715,7 +4296,8 @@ bool freeze_workqueues_busy(void)
 		list_for_each_entry(wq, &workqueues, list) {
 			struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
 
-			if (!cwq || !(wq->flags & WQ_FREEZABLE))
+			if (!cwq || cwq->gcwq != gcwq ||
+			    !(wq->flags & WQ_FREEZABLE))
 				continue;
 
 			BUG_ON(cwq->nr_active < 0);
@@ -3760,7 +4342,8 @@ void thaw_workqueues(void)
 		list_for_each_entry(wq, &workqueues, list) {
 			struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
 
-			if (!cwq || !(wq->flags & WQ_FREEZABLE))
+			if (!cwq || cwq->gcwq != gcwq ||
+			    !(wq->flags & WQ_FREEZABLE))
 				continue;
 
 			/* restore max_active and repopulate worklist */
@@ -3814,6 +4397,8 @@ static int __init init_workqueues(void)
 
 		gcwq->trustee_state = TRUSTEE_DONE;
 		init_waitqueue_head(&gcwq->trustee_wait);
+
+		seqcount_init(&gcwq->attrs_seq);
 	}
 
 	/* create the initial worker */
@@ -3833,7 +4418,8 @@ static int __init init_workqueues(void)
 	system_wq = alloc_workqueue("events", 0, 0);
 	system_long_wq = alloc_workqueue("events_long", 0, 0);
 	system_nrt_wq = alloc_workqueue("events_nrt", WQ_NON_REENTRANT, 0);
-	system_unbound_wq = alloc_workqueue("events_unbound", WQ_UNBOUND,
+	system_unbound_wq = alloc_workqueue("events_unbound",
+					    WQ_UNBOUND | WQ_SYSFS,
 					    WQ_UNBOUND_MAX_ACTIVE);
 	system_freezable_wq = alloc_workqueue("events_freezable",
 					      WQ_FREEZABLE, 0);
@@ -3845,3 +4431,38 @@ static int __init init_workqueues(void)
 	return 0;
 }
 early_initcall(init_workqueues);
+
+#ifdef CONFIG_SYSFS
+static int __init wq_sysfs_init(void)
+{
+	struct workqueue_struct *wq;
+	int ret;
+
+	ret = bus_register(&wq_subsys);
+	if (ret)
+		return ret;
+
+	mutex_lock(&wq_pool_mutex);
+
+	wq_sysfs_root = root_device_register("workqueue");
+	if (IS_ERR(wq_sysfs_root)) {
+		ret = PTR_ERR(wq_sysfs_root);
+		wq_sysfs_root = NULL;
+		goto out_unlock;
+	}
+
+	/*
+	 * Pick up the WQ_SYSFS workqueues allocated before the bus was
+	 * up.  Nothing destroys workqueues this early in boot, so the
+	 * list can be walked without workqueue_lock.
+	 */
+	list_for_each_entry(wq, &workqueues, list)
+		if (wq->flags & WQ_SYSFS && wq_sysfs_register(wq))
+			printk(KERN_WARNING "workqueue: failed to register "
+			       "%s with sysfs\n", wq->name);
+out_unlock:
+	mutex_unlock(&wq_pool_mutex);
+	return ret;
+}
+core_initcall(wq_sysfs_init);
+#endif
@@ -0,0 +1,138 @@
+/*
+ * Slab allocator microbenchmark
+ *
+ * Reports the average cost in ns of kmalloc() and kfree() for each of the
+ * kmalloc size classes, for three patterns:
+ *
+ *  - allocate a batch of objects, then free them all on the same cpu,
+ *    which goes through the slow paths and the partial lists;
+ *  - allocate and immediately free one object, the fast path;
+ *  - allocate a batch on one cpu and free it from another one, which
+ *    frees into slabs that are not the cpu slab of the freeing cpu.
+ *
+ * The results are printed to the kernel log on module load; unload the
+ * module before loading it again for the next run.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/smp.h>
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+
+static unsigned int nr_objs = 10000;
+module_param(nr_objs, uint, 0444);
+MODULE_PARM_DESC(nr_objs, "Number of objects per batch");
+
+static void **objs;
+
+static unsigned long long ns_per_obj(ktime_t start, ktime_t end)
+{
+	return div_u64(ktime_to_ns(ktime_sub(end, start)), nr_objs);
+}
+
+static void free_batch(void *unused)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_objs; i++)
+		kfree(objs[i]);
+}
+
+static void bench_batch(size_t size)
+{
+	unsigned long long alloc_ns, free_ns;
+	ktime_t t0, t1, t2;
+	unsigned int i;
+
+	t0 = ktime_get();
+	for (i = 0; i < nr_objs; i++)
+		objs[i] = kmalloc(size, GFP_KERNEL);
+	t1 = ktime_get();
+	free_batch(NULL);
+	t2 = ktime_get();
+
+	alloc_ns = ns_per_obj(t0, t1);
+	free_ns = ns_per_obj(t1, t2);
+	printk(KERN_INFO "slab_bench: %5zu bytes: batch  alloc %4llu ns, "
+		"free %4llu ns\n", size, alloc_ns, free_ns);
+}
+
+static void bench_pair(size_t size)
+{
+	ktime_t t0, t1;
+	unsigned int i;
+
+	t0 = ktime_get();
+	for (i = 0; i < nr_objs; i++)
+		kfree(kmalloc(size, GFP_KERNEL));
+	t1 = ktime_get();
+
+	printk(KERN_INFO "slab_bench: %5zu bytes: alloc+free pair %4llu ns\n",
+		size, ns_per_obj(t0, t1));
+}
+
+static void bench_remote(size_t size)
+{
+	unsigned long long alloc_ns, free_ns;
+	ktime_t t0, t1, t2;
+	unsigned int i;
+	int cpu, target;
+
+	cpu = get_cpu();
+	target = cpumask_any_but(cpu_online_mask, cpu);
+	put_cpu();
+	if (target >= nr_cpu_ids)
+		return;
+
+	t0 = ktime_get();
+	for (i = 0; i < nr_objs; i++)
+		objs[i] = kmalloc(size, GFP_KERNEL);
+	t1 = ktime_get();
+	smp_call_function_single(target, free_batch, NULL, 1);
+	t2 = ktime_get();
+
+	alloc_ns = ns_per_obj(t0, t1);
+	free_ns = ns_per_obj(t1, t2);
+	printk(KERN_INFO "slab_bench: %5zu bytes: remote alloc %4llu ns, "
+		"free %4llu ns\n", size, alloc_ns, free_ns);
+}
+
+static int __init slab_bench_init(void)
+{
+	size_t size;
+
+	if (!nr_objs)
+		return -EINVAL;
+
+	objs = vmalloc(nr_objs * sizeof(void *));
+	if (!objs)
+		return -ENOMEM;
+
+	printk(KERN_INFO "slab_bench: %u objects per test\n", nr_objs);
+	for (size = 8; size <= PAGE_SIZE; size <<= 1) {
+		bench_batch(size);
+		bench_pair(size);
+		bench_remote(size);
+		cond_resched();
+	}
+
+	vfree(objs);
+	return 0;
+}
+
+static void __exit slab_bench_exit(void)
+{
+}
+
+module_init(slab_bench_init);
+module_exit(slab_bench_exit);
+MODULE_LICENSE("GPL");
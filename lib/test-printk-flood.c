@@ -0,0 +1,119 @@
+/*
+ * printk() flood test.
+ *
+ * Each thread prints nr_messages lines of msg_len characters at loglevel
+ * level and records how long every printk() call took.  Once all of them
+ * are done, the average and worst case per thread are reported.  With a
+ * slow serial console and a loglevel that reaches it, this shows how much
+ * console output is charged to the callers of printk().
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/err.h>
+
+static int flood_threads;
+module_param_named(nr_threads, flood_threads, int, 0444);
+MODULE_PARM_DESC(nr_threads, "Number of printing threads (default: online CPUs)");
+
+static int nr_messages = 10000;
+module_param(nr_messages, int, 0444);
+MODULE_PARM_DESC(nr_messages, "Number of messages per thread");
+
+static int msg_len = 80;
+module_param(msg_len, int, 0444);
+MODULE_PARM_DESC(msg_len, "Length of each message");
+
+static int level = 6;
+module_param(level, int, 0444);
+MODULE_PARM_DESC(level, "Loglevel of the messages, 0-7");
+
+struct flood_thread {
+	struct task_struct *task;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+static atomic_t flood_running;
+static DECLARE_COMPLETION(flood_done);
+static char flood_text[256];
+
+static int flood_thread_fn(void *arg)
+{
+	struct flood_thread *ft = arg;
+	u64 t, delta;
+	int i;
+
+	for (i = 0; i < nr_messages; i++) {
+		t = local_clock();
+		printk("<%d>printk-flood %d: %s\n", level, i, flood_text);
+		delta = local_clock() - t;
+
+		ft->total_ns += delta;
+		if (delta > ft->max_ns)
+			ft->max_ns = delta;
+		cond_resched();
+	}
+
+	if (atomic_dec_and_test(&flood_running))
+		complete(&flood_done);
+	return 0;
+}
+
+static int __init test_printk_flood_init(void)
+{
+	struct flood_thread *threads;
+	u64 start, elapsed;
+	int i;
+
+	if (flood_threads <= 0)
+		flood_threads = num_online_cpus();
+	if (nr_messages <= 0 || level < 0 || level > 7)
+		return -EINVAL;
+	msg_len = clamp(msg_len, 1, (int)sizeof(flood_text) - 1);
+	memset(flood_text, 'x', msg_len);
+
+	threads = kcalloc(flood_threads, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+
+	atomic_set(&flood_running, flood_threads);
+	start = local_clock();
+	for (i = 0; i < flood_threads; i++) {
+		threads[i].task = kthread_run(flood_thread_fn, &threads[i],
+					      "printk-flood/%d", i);
+		if (IS_ERR(threads[i].task)) {
+			/* Account for the threads that will never finish */
+			if (atomic_sub_and_test(flood_threads - i, &flood_running))
+				complete(&flood_done);
+			flood_threads = i;
+			break;
+		}
+	}
+	wait_for_completion(&flood_done);
+	elapsed = local_clock() - start;
+
+	for (i = 0; i < flood_threads; i++)
+		printk(KERN_INFO "printk-flood: thread %d: %d messages, "
+		       "avg %llu ns, max %llu ns\n", i, nr_messages,
+		       div_u64(threads[i].total_ns, nr_messages),
+		       threads[i].max_ns);
+	printk(KERN_INFO "printk-flood: %d threads took %llu us\n",
+	       flood_threads, div_u64(elapsed, NSEC_PER_USEC));
+
+	kfree(threads);
+	return 0;
+}
+
+static void __exit test_printk_flood_exit(void)
+{
+}
+
+module_init(test_printk_flood_init);
+module_exit(test_printk_flood_exit);
+MODULE_LICENSE("GPL");
@@ -16,6 +16,7 @@
 #include <linux/kmemleak.h>
 #include <linux/range.h>
 #include <linux/memblock.h>
+#include <linux/sched.h>
 
 #include <asm/bug.h>
 #include <asm/io.h>
@@ -169,9 +170,152 @@ void __init free_bootmem_late(unsigned long addr, unsigned long size)
 	}
 }
 
+/* Are the pages [pfn, pfn + nr) all free? */
+static int __init bootmem_range_free(bootmem_data_t *bdata,
+				     unsigned long pfn, unsigned long nr)
+{
+	unsigned long idx = pfn - bdata->node_min_pfn;
+
+	return find_next_bit(bdata->node_bootmem_map, idx + nr, idx) >=
+		idx + nr;
+}
+
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+/*
+ * The free pages of a node beyond pgdat->first_deferred_pfn are counted
+ * by free_all_bootmem_core(), but only initialised and released later
+ * by deferred_free_bootmem_range(), which finds them in the bitmap.
+ * So the bitmap is kept until deferred_free_bootmem_map().
+ */
+static int __init bootmem_deferred(bootmem_data_t *bdata)
+{
+	pg_data_t *pgdat = NODE_DATA(bdata - bootmem_node_data);
+
+	return pgdat->first_deferred_pfn < bdata->node_low_pfn;
+}
+
+/*
+ * Initialise the reserved pages from @start on, the deferred free ones
+ * are only counted.
+ */
+static unsigned long __init deferred_init_reserved(bootmem_data_t *bdata,
+						   unsigned long start)
+{
+	pg_data_t *pgdat = NODE_DATA(bdata - bootmem_node_data);
+	unsigned long *map = bdata->node_bootmem_map;
+	unsigned long zone = pgdat->nr_zones - 1;
+	unsigned long idx, eidx, count = 0;
+
+	idx = start - bdata->node_min_pfn;
+	eidx = bdata->node_low_pfn - bdata->node_min_pfn;
+	while (idx < eidx) {
+		if (!(idx % BITS_PER_LONG) && idx + BITS_PER_LONG <= eidx &&
+		    !map[idx / BITS_PER_LONG]) {
+			count += BITS_PER_LONG;
+			idx += BITS_PER_LONG;
+			continue;
+		}
+		if (!test_bit(idx, map))
+			count++;
+		else if (pfn_valid(bdata->node_min_pfn + idx))
+			__init_single_pfn(bdata->node_min_pfn + idx, zone,
+					  pgdat->node_id);
+		idx++;
+	}
+
+	return count;
+}
+
+/**
+ * deferred_free_bootmem_range - initialise and release deferred pages
+ * @nid: node the range resides on
+ * @start_pfn: first page frame of the range
+ * @end_pfn: page frame after the range
+ *
+ * Initialises the struct pages of the free pages in the range and
+ * releases them to the buddy allocator, in MAX_ORDER blocks where
+ * possible.  Ranges of a node may be handled in parallel.
+ *
+ * Returns the number of pages released.
+ */
+unsigned long __init deferred_free_bootmem_range(int nid,
+			unsigned long start_pfn, unsigned long end_pfn)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	bootmem_data_t *bdata = pgdat->bdata;
+	unsigned long zone = pgdat->nr_zones - 1;
+	unsigned long pfn, i, count = 0;
+
+	start_pfn = max(start_pfn, bdata->node_min_pfn);
+	end_pfn = min(end_pfn, bdata->node_low_pfn);
+
+	pfn = start_pfn;
+	while (pfn < end_pfn) {
+		if (!(pfn & (MAX_ORDER_NR_PAGES - 1)) &&
+		    pfn + MAX_ORDER_NR_PAGES <= end_pfn &&
+		    bootmem_range_free(bdata, pfn, MAX_ORDER_NR_PAGES)) {
+			for (i = 0; i < MAX_ORDER_NR_PAGES; i++)
+				__init_single_page(pfn + i, zone, nid);
+			__free_pages_bootmem(pfn_to_page(pfn), MAX_ORDER - 1);
+			count += MAX_ORDER_NR_PAGES;
+			pfn += MAX_ORDER_NR_PAGES;
+			cond_resched();
+			continue;
+		}
+		if (!test_bit(pfn - bdata->node_min_pfn,
+			      bdata->node_bootmem_map)) {
+			__init_single_page(pfn, zone, nid);
+			__free_pages_bootmem(pfn_to_page(pfn), 0);
+			count++;
+		}
+		pfn++;
+	}
+
+	bdebug("nid=%d start=%lx end=%lx released=%lx\n",
+		nid, start_pfn, end_pfn, count);
+
+	return count;
+}
+
+/**
+ * deferred_free_bootmem_map - release a node's bootmem bitmap
+ * @nid: node
+ *
+ * Releases the bitmap kept for deferred_free_bootmem_range(), once
+ * all ranges of the node are done.
+ */
+void __init deferred_free_bootmem_map(int nid)
+{
+	bootmem_data_t *bdata = NODE_DATA(nid)->bdata;
+	struct page *page;
+	unsigned long pages;
+
+	if (!bdata->node_bootmem_map || !bootmem_deferred(bdata))
+		return;
+
+	page = virt_to_page(bdata->node_bootmem_map);
+	pages = bdata->node_low_pfn - bdata->node_min_pfn;
+	pages = bootmem_bootmap_pages(pages);
+	while (pages--)
+		__free_pages_bootmem(page++, 0);
+	bdata->node_bootmem_map = NULL;
+}
+#else
+static inline int bootmem_deferred(bootmem_data_t *bdata)
+{
+	return 0;
+}
+
+static inline unsigned long deferred_init_reserved(bootmem_data_t *bdata,
+						   unsigned long start)
+{
+	return 0;
+}
+#endif /* CONFIG_DEFERRED_STRUCT_PAGE_INIT */
+
 static unsigned long __init free_all_bootmem_core(bootmem_data_t *bdata)
 {
-	int aligned;
+	int aligned, deferred;
 	struct page *page;
 	unsigned long start, end, pages, count = 0;
 
@@ -181,6 +325,12 @@ static unsigned long __init free_all_bootmem_core(bootmem_data_t *bdata)
 	start = bdata->node_min_pfn;
 	end = bdata->node_low_pfn;
 
+	deferred = bootmem_deferred(bdata);
+	if (deferred) {
+		end = NODE_DATA(bdata - bootmem_node_data)->first_deferred_pfn;
+		count += deferred_init_reserved(bdata, end);
+	}
+
 	/*
 	 * If the start is aligned to the machines wordsize, we might
 	 * be able to free pages in bulks of that order.
@@ -197,6 +347,19 @@ static unsigned long __init free_all_bootmem_core(bootmem_data_t *bdata)
 		idx = start - bdata->node_min_pfn;
 		vec = ~map[idx / BITS_PER_LONG];
 
+		/* Release whole MAX_ORDER blocks of one zone at once */
+		if (aligned && !(start & (MAX_ORDER_NR_PAGES - 1)) &&
+		    start + MAX_ORDER_NR_PAGES <= end &&
+		    bootmem_range_free(bdata, start, MAX_ORDER_NR_PAGES) &&
+		    page_zone_id(pfn_to_page(start)) ==
+		    page_zone_id(pfn_to_page(start + MAX_ORDER_NR_PAGES - 1))) {
+			__free_pages_bootmem(pfn_to_page(start),
+					     MAX_ORDER - 1);
+			count += MAX_ORDER_NR_PAGES;
+			start += MAX_ORDER_NR_PAGES;
+			continue;
+		}
+
 		if (aligned && vec == ~0UL && start + BITS_PER_LONG < end) {
 			int order = ilog2(BITS_PER_LONG);
 
@@ -205,7 +368,8 @@ static unsigned long __init free_all_bootmem_core(bootmem_data_t *bdata)
 		} else {
 			unsigned long off = 0;
 
-			while (vec && off < BITS_PER_LONG) {
+			while (vec && off < BITS_PER_LONG &&
+			       start + off < end) {
 				if (vec & 1) {
 					page = pfn_to_page(start + off);
 					__free_pages_bootmem(page, 0);
@@ -222,7 +386,8 @@ static unsigned long __init free_all_bootmem_core(bootmem_data_t *bdata)
 	pages = bdata->node_low_pfn - bdata->node_min_pfn;
 	pages = bootmem_bootmap_pages(pages);
 	count += pages;
-	while (pages--)
+	/* Still needed for the deferred pages, see bootmem_deferred() */
+	while (!deferred && pages--)
 		__free_pages_bootmem(page++, 0);
 
 	bdebug("nid=%td released=%lx\n", bdata - bootmem_node_data, count);
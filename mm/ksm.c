@@ -23,7 +23,6 @@
 #include <linux/pagemap.h>
 #include <linux/rmap.h>
 #include <linux/spinlock.h>
-#include <linux/jhash.h>
 #include <linux/delay.h>
 #include <linux/kthread.h>
 #include <linux/wait.h>
@@ -78,20 +77,30 @@
  *    take 10 attempts to find a page in the unstable tree, once it is found,
  *    it is secured in the stable tree.  (When we scan a new page, we first
  *    compare it against the stable tree, and then against the unstable tree.)
+ *
+ * The scan can be split between several ksmd threads (scan_threads in
+ * sysfs), each walking its own list of mm_slots with its own cursor.  They
+ * share the trees under ksm_tree_mutex, and only what happens before a page
+ * is looked up in a tree - walking page tables, checksumming - runs in
+ * parallel.  A round ends when every thread has completed its list: only
+ * then is the unstable tree flushed, so that pages of different threads can
+ * still meet in it.
  */
 
 /**
  * struct mm_slot - ksm information per mm that is being scanned
  * @link: link to the mm_slots hash list
- * @mm_list: link into the mm_slots list, rooted in ksm_mm_head
+ * @mm_list: link into the mm_slots list, rooted in its worker's mm_head
  * @rmap_list: head for this mm_slot's singly-linked list of rmap_items
  * @mm: the mm that this information is valid for
+ * @worker: the scanning thread whose list this mm_slot is on
  */
 struct mm_slot {
 	struct hlist_node link;
 	struct list_head mm_list;
 	struct rmap_item *rmap_list;
 	struct mm_struct *mm;
+	struct ksm_worker *worker;
 };
 
 /**
@@ -99,15 +108,36 @@ struct mm_slot {
  * @mm_slot: the current mm_slot we are scanning
  * @address: the next address inside that to be scanned
  * @rmap_list: link to the next rmap to be scanned in the rmap_list
- * @seqnr: count of completed full scans (needed when removing unstable node)
  *
- * There is only the one ksm_scan instance of this cursor structure.
+ * There is one ksm_scan cursor per scanning thread.
  */
 struct ksm_scan {
 	struct mm_slot *mm_slot;
 	unsigned long address;
 	struct rmap_item **rmap_list;
-	unsigned long seqnr;
+};
+
+/**
+ * struct ksm_worker - a ksmd thread
+ * @mm_head: head of this thread's list of mm_slots
+ * @scan: this thread's cursor into that list
+ * @stale: rmap_items unlinked under mmap_sem, still to be removed from
+ *	the trees once the thread can take ksm_tree_mutex
+ * @thread: the kthread, once started
+ * @id: index into ksm_workers[]
+ * @done: the thread has completed its list in the current round
+ * @pages_scanned: pages this thread has looked at
+ * @pages_merged: rmap_items this thread has added to the stable tree
+ */
+struct ksm_worker {
+	struct mm_slot mm_head;
+	struct ksm_scan scan;
+	struct rmap_item *stale;
+	struct task_struct *thread;
+	int id;
+	int done;
+	unsigned long pages_scanned;
+	unsigned long pages_merged;
 };
 
 /**
@@ -160,12 +190,20 @@ static struct rb_root root_unstable_tree = RB_ROOT;
 #define MM_SLOTS_HASH_HEADS (1 << MM_SLOTS_HASH_SHIFT)
 static struct hlist_head mm_slots_hash[MM_SLOTS_HASH_HEADS];
 
-static struct mm_slot ksm_mm_head = {
-	.mm_list = LIST_HEAD_INIT(ksm_mm_head.mm_list),
-};
-static struct ksm_scan ksm_scan = {
-	.mm_slot = &ksm_mm_head,
-};
+#define KSM_MAX_WORKERS 16
+static struct ksm_worker ksm_workers[KSM_MAX_WORKERS];
+
+/* Number of ksmd threads sharing the scan */
+static int ksm_nr_workers = 1;
+
+/* Threads which have completed their list in the current round */
+static int ksm_workers_done;
+
+/* Next thread to hand a new mm_slot to */
+static int ksm_next_worker;
+
+/* Count of completed rounds (needed when removing unstable node) */
+static unsigned long ksm_seqnr;
 
 static struct kmem_cache *rmap_item_cache;
 static struct kmem_cache *stable_node_cache;
@@ -181,9 +219,9 @@ static unsigned long ksm_pages_sharing;
 static unsigned long ksm_pages_unshared;
 
 /* The number of rmap_items in use: to calculate pages_volatile */
-static unsigned long ksm_rmap_items;
+static atomic_long_t ksm_rmap_items = ATOMIC_LONG_INIT(0);
 
-/* Number of pages ksmd should scan in one batch */
+/* Number of pages ksmd should scan in one batch, shared by its threads */
 static unsigned int ksm_thread_pages_to_scan = 100;
 
 /* Milliseconds ksmd should sleep between batches */
@@ -194,8 +232,15 @@ static unsigned int ksm_thread_sleep_millisecs = 20;
 #define KSM_RUN_UNMERGE	2
 static unsigned int ksm_run = KSM_RUN_STOP;
 
+/*
+ * ksm_thread_sem is held for read by the ksmd threads while they scan,
+ * and for write by whoever needs them out of the way.  Between themselves
+ * the threads serialize on ksm_tree_mutex for the trees, the counters
+ * above and ksm_seqnr.  Never take ksm_tree_mutex with mmap_sem held.
+ */
 static DECLARE_WAIT_QUEUE_HEAD(ksm_thread_wait);
-static DEFINE_MUTEX(ksm_thread_mutex);
+static DECLARE_RWSEM(ksm_thread_sem);
+static DEFINE_MUTEX(ksm_tree_mutex);
 static DEFINE_SPINLOCK(ksm_mmlist_lock);
 
 #define KSM_KMEM_CACHE(__struct, __flags) kmem_cache_create("ksm_"#__struct,\
@@ -240,13 +285,13 @@ static inline struct rmap_item *alloc_rmap_item(void)
 
 	rmap_item = kmem_cache_zalloc(rmap_item_cache, GFP_KERNEL);
 	if (rmap_item)
-		ksm_rmap_items++;
+		atomic_long_inc(&ksm_rmap_items);
 	return rmap_item;
 }
 
 static inline void free_rmap_item(struct rmap_item *rmap_item)
 {
-	ksm_rmap_items--;
+	atomic_long_dec(&ksm_rmap_items);
 	rmap_item->mm = NULL;	/* debug safety */
 	kmem_cache_free(rmap_item_cache, rmap_item);
 }
@@ -480,7 +525,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
  * a page to put something that might look like our key in page->mapping.
  *
  * include/linux/pagemap.h page_cache_get_speculative() is a good reference,
- * but this is different - made simpler by ksm_thread_mutex being held, but
+ * but this is different - made simpler by ksm_tree_mutex being held, but
  * interesting for assuming that no other use of the struct page could ever
  * put our expected_mapping into page->mapping (or a field of the union which
  * coincides with page->mapping).  The RCU calls are not for KSM at all, but
@@ -553,7 +598,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 		 * if this rmap_item was inserted by this scan, rather
 		 * than left over from before.
 		 */
-		age = (unsigned char)(ksm_scan.seqnr - rmap_item->address);
+		age = (unsigned char)(ksm_seqnr - rmap_item->address);
 		BUG_ON(age > 1);
 		if (!age)
 			rb_erase(&rmap_item->node, &root_unstable_tree);
@@ -565,14 +610,44 @@ out:
 	cond_resched();		/* we're called from many long loops */
 }
 
+/*
+ * Only a slot's own thread (or unmerge, with the threads locked out)
+ * modifies its rmap_list, but it does so holding the mm's mmap_sem, under
+ * which ksm_tree_mutex must not be taken.  So rmap_items to be freed are
+ * just unlinked onto the thread's stale list, and removed from the trees
+ * later by free_stale_rmap_items().
+ */
+static void stale_rmap_item(struct ksm_worker *worker,
+			    struct rmap_item *rmap_item)
+{
+	rmap_item->rmap_list = worker->stale;
+	worker->stale = rmap_item;
+}
+
+static void free_stale_rmap_items(struct ksm_worker *worker)
+{
+	struct rmap_item *rmap_item;
+
+	if (!worker->stale)
+		return;
+
+	mutex_lock(&ksm_tree_mutex);
+	while (worker->stale) {
+		rmap_item = worker->stale;
+		worker->stale = rmap_item->rmap_list;
+		remove_rmap_item_from_tree(rmap_item);
+		free_rmap_item(rmap_item);
+	}
+	mutex_unlock(&ksm_tree_mutex);
+}
+
 static void remove_trailing_rmap_items(struct mm_slot *mm_slot,
 				       struct rmap_item **rmap_list)
 {
 	while (*rmap_list) {
 		struct rmap_item *rmap_item = *rmap_list;
 		*rmap_list = rmap_item->rmap_list;
-		remove_rmap_item_from_tree(rmap_item);
-		free_rmap_item(rmap_item);
+		stale_rmap_item(mm_slot->worker, rmap_item);
 	}
 }
 
@@ -607,75 +682,136 @@ static int unmerge_ksm_pages(struct vm_area_struct *vma,
 }
 
 #ifdef CONFIG_SYSFS
+/*
+ * Start a new round from the top of every thread's list, forgetting the
+ * unstable tree as if the last round had been completed.  Called with
+ * ksm_thread_sem held for write, when the cursors or the split of mm_slots
+ * between threads have been changed under the threads' feet.
+ */
+static void ksm_restart_scan(void)
+{
+	struct ksm_worker *worker;
+	struct mm_slot *mm_slot;
+	struct rmap_item *rmap_item;
+	int i;
+
+	spin_lock(&ksm_mmlist_lock);
+	for (i = 0; i < ksm_nr_workers; i++) {
+		worker = &ksm_workers[i];
+		list_for_each_entry(mm_slot, &worker->mm_head.mm_list, mm_list)
+			for (rmap_item = mm_slot->rmap_list; rmap_item;
+			     rmap_item = rmap_item->rmap_list) {
+				if (!(rmap_item->address & UNSTABLE_FLAG))
+					continue;
+				rmap_item->address &= PAGE_MASK;
+				ksm_pages_unshared--;
+			}
+		worker->scan.mm_slot = &worker->mm_head;
+		worker->done = 0;
+	}
+	spin_unlock(&ksm_mmlist_lock);
+
+	root_unstable_tree = RB_ROOT;
+	ksm_workers_done = 0;
+}
+
 /*
  * Only called through the sysfs control interface:
  */
 static int unmerge_and_remove_all_rmap_items(void)
 {
+	struct ksm_worker *worker;
 	struct mm_slot *mm_slot;
 	struct mm_struct *mm;
 	struct vm_area_struct *vma;
-	int err = 0;
+	int i, err = 0;
 
-	spin_lock(&ksm_mmlist_lock);
-	ksm_scan.mm_slot = list_entry(ksm_mm_head.mm_list.next,
+	for (i = 0; i < ksm_nr_workers; i++) {
+		worker = &ksm_workers[i];
+
+		spin_lock(&ksm_mmlist_lock);
+		worker->scan.mm_slot = list_entry(worker->mm_head.mm_list.next,
 						struct mm_slot, mm_list);
-	spin_unlock(&ksm_mmlist_lock);
+		spin_unlock(&ksm_mmlist_lock);
 
-	for (mm_slot = ksm_scan.mm_slot;
-			mm_slot != &ksm_mm_head; mm_slot = ksm_scan.mm_slot) {
-		mm = mm_slot->mm;
-		down_read(&mm->mmap_sem);
-		for (vma = mm->mmap; vma; vma = vma->vm_next) {
-			if (ksm_test_exit(mm))
-				break;
-			if (!(vma->vm_flags & VM_MERGEABLE) || !vma->anon_vma)
-				continue;
-			err = unmerge_ksm_pages(vma,
+		for (mm_slot = worker->scan.mm_slot;
+				mm_slot != &worker->mm_head;
+				mm_slot = worker->scan.mm_slot) {
+			mm = mm_slot->mm;
+			down_read(&mm->mmap_sem);
+			for (vma = mm->mmap; vma; vma = vma->vm_next) {
+				if (ksm_test_exit(mm))
+					break;
+				if (!(vma->vm_flags & VM_MERGEABLE) ||
+				    !vma->anon_vma)
+					continue;
+				err = unmerge_ksm_pages(vma,
 						vma->vm_start, vma->vm_end);
-			if (err)
-				goto error;
-		}
+				if (err)
+					goto error;
+			}
 
-		remove_trailing_rmap_items(mm_slot, &mm_slot->rmap_list);
+			remove_trailing_rmap_items(mm_slot,
+						   &mm_slot->rmap_list);
 
-		spin_lock(&ksm_mmlist_lock);
-		ksm_scan.mm_slot = list_entry(mm_slot->mm_list.next,
-						struct mm_slot, mm_list);
-		if (ksm_test_exit(mm)) {
-			hlist_del(&mm_slot->link);
-			list_del(&mm_slot->mm_list);
-			spin_unlock(&ksm_mmlist_lock);
+			spin_lock(&ksm_mmlist_lock);
+			worker->scan.mm_slot = list_entry(
+					mm_slot->mm_list.next,
+					struct mm_slot, mm_list);
+			if (ksm_test_exit(mm)) {
+				hlist_del(&mm_slot->link);
+				list_del(&mm_slot->mm_list);
+				spin_unlock(&ksm_mmlist_lock);
 
-			free_mm_slot(mm_slot);
-			clear_bit(MMF_VM_MERGEABLE, &mm->flags);
-			up_read(&mm->mmap_sem);
-			mmdrop(mm);
-		} else {
-			spin_unlock(&ksm_mmlist_lock);
-			up_read(&mm->mmap_sem);
+				free_mm_slot(mm_slot);
+				clear_bit(MMF_VM_MERGEABLE, &mm->flags);
+				up_read(&mm->mmap_sem);
+				free_stale_rmap_items(worker);
+				mmdrop(mm);
+			} else {
+				spin_unlock(&ksm_mmlist_lock);
+				up_read(&mm->mmap_sem);
+				free_stale_rmap_items(worker);
+			}
 		}
 	}
 
-	ksm_scan.seqnr = 0;
+	ksm_restart_scan();
+	ksm_seqnr = 0;
 	return 0;
 
 error:
 	up_read(&mm->mmap_sem);
-	spin_lock(&ksm_mmlist_lock);
-	ksm_scan.mm_slot = &ksm_mm_head;
-	spin_unlock(&ksm_mmlist_lock);
+	free_stale_rmap_items(worker);
+	ksm_restart_scan();
 	return err;
 }
 #endif /* CONFIG_SYSFS */
 
+/*
+ * The checksum only has to tell whether a page changed since the last
+ * round: merging is always decided by memcmp_pages() on write-protected
+ * pages.  So instead of jhash2 over the whole page, fold in a sample: the
+ * first KSM_CHECKSUM_CHUNK bytes of every KSM_CHECKSUM_STRIDE.  A page
+ * written only outside the sample is taken for unchanged, which costs a
+ * trip through the unstable tree, no more.
+ */
+#define KSM_CHECKSUM_STRIDE	256
+#define KSM_CHECKSUM_CHUNK	64
+
 static u32 calc_checksum(struct page *page)
 {
-	u32 checksum;
-	void *addr = kmap_atomic(page, KM_USER0);
-	checksum = jhash2(addr, PAGE_SIZE / 4, 17);
+	unsigned long *addr = kmap_atomic(page, KM_USER0);
+	unsigned long sum = 17;
+	unsigned int i, j;
+
+	for (i = 0; i < PAGE_SIZE / sizeof(long);
+	     i += KSM_CHECKSUM_STRIDE / sizeof(long))
+		for (j = 0; j < KSM_CHECKSUM_CHUNK / sizeof(long); j++)
+			sum = ((sum << 5) | (sum >> (BITS_PER_LONG - 5))) ^
+				addr[i + j];
 	kunmap_atomic(addr, KM_USER0);
-	return checksum;
+	return hash_long(sum, 32);
 }
 
 static int memcmp_pages(struct page *page1, struct page *page2)
@@ -1133,7 +1269,7 @@ struct rmap_item *unstable_tree_search_insert(struct rmap_item *rmap_item,
 	}
 
 	rmap_item->address |= UNSTABLE_FLAG;
-	rmap_item->address |= (ksm_scan.seqnr & SEQNR_MASK);
+	rmap_item->address |= (ksm_seqnr & SEQNR_MASK);
 	rb_link_node(&rmap_item->node, parent, new);
 	rb_insert_color(&rmap_item->node, &root_unstable_tree);
 
@@ -1165,16 +1301,19 @@ static void stable_tree_append(struct rmap_item *rmap_item,
  * be inserted into the unstable tree, or merged with a page already there and
  * both transferred to the stable tree.
  *
+ * @worker: the ksmd thread doing it, holding ksm_tree_mutex
  * @page: the page that we are searching identical page to.
  * @rmap_item: the reverse mapping into the virtual address of this page
+ * @checksum: calc_checksum() of the page, taken without ksm_tree_mutex
  */
-static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
+static void cmp_and_merge_page(struct ksm_worker *worker, struct page *page,
+			       struct rmap_item *rmap_item,
+			       unsigned int checksum)
 {
 	struct rmap_item *tree_rmap_item;
 	struct page *tree_page = NULL;
 	struct stable_node *stable_node;
 	struct page *kpage;
-	unsigned int checksum;
 	int err;
 
 	remove_rmap_item_from_tree(rmap_item);
@@ -1191,6 +1330,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			lock_page(kpage);
 			stable_tree_append(rmap_item, page_stable_node(kpage));
 			unlock_page(kpage);
+			worker->pages_merged++;
 		}
 		put_page(kpage);
 		return;
@@ -1202,7 +1342,6 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 	 * don't want to insert it in the unstable tree, and we don't want
 	 * to waste our time searching for something identical to it there.
 	 */
-	checksum = calc_checksum(page);
 	if (rmap_item->oldchecksum != checksum) {
 		rmap_item->oldchecksum = checksum;
 		return;
@@ -1227,6 +1366,7 @@ static void cmp_and_merge_page(struct page *page, struct rmap_item *rmap_item)
 			if (stable_node) {
 				stable_tree_append(tree_rmap_item, stable_node);
 				stable_tree_append(rmap_item, stable_node);
+				worker->pages_merged += 2;
 			}
 			unlock_page(kpage);
 
@@ -1257,8 +1397,7 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 		if (rmap_item->address > addr)
 			break;
 		*rmap_list = rmap_item->rmap_list;
-		remove_rmap_item_from_tree(rmap_item);
-		free_rmap_item(rmap_item);
+		stale_rmap_item(mm_slot->worker, rmap_item);
 	}
 
 	rmap_item = alloc_rmap_item();
@@ -1272,18 +1411,18 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
-static struct rmap_item *scan_get_next_rmap_item(struct page **page)
+/*
+ * ksm_worker_done - a thread has come to the end of its list.  The round
+ * ends with the last thread to get there, which flushes the unstable tree
+ * and sets all of them off again.
+ */
+static void ksm_worker_done(struct ksm_worker *worker)
 {
-	struct mm_struct *mm;
-	struct mm_slot *slot;
-	struct vm_area_struct *vma;
-	struct rmap_item *rmap_item;
-
-	if (list_empty(&ksm_mm_head.mm_list))
-		return NULL;
+	int i;
 
-	slot = ksm_scan.mm_slot;
-	if (slot == &ksm_mm_head) {
+	mutex_lock(&ksm_tree_mutex);
+	worker->done = 1;
+	if (++ksm_workers_done >= ksm_nr_workers) {
 		/*
 		 * A number of pages can hang around indefinitely on per-cpu
 		 * pagevecs, raised page count preventing write_protect_page
@@ -1297,20 +1436,45 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 		lru_add_drain_all();
 
 		root_unstable_tree = RB_ROOT;
+		ksm_seqnr++;
+
+		ksm_workers_done = 0;
+		for (i = 0; i < ksm_nr_workers; i++)
+			ksm_workers[i].done = 0;
+		wake_up_interruptible(&ksm_thread_wait);
+	}
+	mutex_unlock(&ksm_tree_mutex);
+}
+
+static struct rmap_item *scan_get_next_rmap_item(struct ksm_worker *worker,
+						 struct page **page)
+{
+	struct ksm_scan *scan = &worker->scan;
+	struct mm_struct *mm;
+	struct mm_slot *slot;
+	struct vm_area_struct *vma;
+	struct rmap_item *rmap_item;
 
+	if (worker->done)
+		return NULL;
+
+	slot = scan->mm_slot;
+	if (slot == &worker->mm_head) {
 		spin_lock(&ksm_mmlist_lock);
 		slot = list_entry(slot->mm_list.next, struct mm_slot, mm_list);
-		ksm_scan.mm_slot = slot;
+		scan->mm_slot = slot;
 		spin_unlock(&ksm_mmlist_lock);
 		/*
-		 * Although we tested list_empty() above, a racing __ksm_exit
-		 * of the last mm on the list may have removed it since then.
+		 * Nothing on our list for this round, or a racing __ksm_exit
+		 * of the last mm on it has removed it since it was checked.
 		 */
-		if (slot == &ksm_mm_head)
+		if (slot == &worker->mm_head) {
+			ksm_worker_done(worker);
 			return NULL;
+		}
 next_mm:
-		ksm_scan.address = 0;
-		ksm_scan.rmap_list = &slot->rmap_list;
+		scan->address = 0;
+		scan->rmap_list = &slot->rmap_list;
 	}
 
 	mm = slot->mm;
@@ -1318,60 +1482,60 @@ next_mm:
 	if (ksm_test_exit(mm))
 		vma = NULL;
 	else
-		vma = find_vma(mm, ksm_scan.address);
+		vma = find_vma(mm, scan->address);
 
 	for (; vma; vma = vma->vm_next) {
 		if (!(vma->vm_flags & VM_MERGEABLE))
 			continue;
-		if (ksm_scan.address < vma->vm_start)
-			ksm_scan.address = vma->vm_start;
+		if (scan->address < vma->vm_start)
+			scan->address = vma->vm_start;
 		if (!vma->anon_vma)
-			ksm_scan.address = vma->vm_end;
+			scan->address = vma->vm_end;
 
-		while (ksm_scan.address < vma->vm_end) {
+		while (scan->address < vma->vm_end) {
 			if (ksm_test_exit(mm))
 				break;
-			*page = follow_page(vma, ksm_scan.address, FOLL_GET);
+			*page = follow_page(vma, scan->address, FOLL_GET);
 			if (IS_ERR_OR_NULL(*page)) {
-				ksm_scan.address += PAGE_SIZE;
+				scan->address += PAGE_SIZE;
 				cond_resched();
 				continue;
 			}
 			if (PageAnon(*page) ||
 			    page_trans_compound_anon(*page)) {
-				flush_anon_page(vma, *page, ksm_scan.address);
+				flush_anon_page(vma, *page, scan->address);
 				flush_dcache_page(*page);
 				rmap_item = get_next_rmap_item(slot,
-					ksm_scan.rmap_list, ksm_scan.address);
+					scan->rmap_list, scan->address);
 				if (rmap_item) {
-					ksm_scan.rmap_list =
+					scan->rmap_list =
 							&rmap_item->rmap_list;
-					ksm_scan.address += PAGE_SIZE;
+					scan->address += PAGE_SIZE;
 				} else
 					put_page(*page);
 				up_read(&mm->mmap_sem);
 				return rmap_item;
 			}
 			put_page(*page);
-			ksm_scan.address += PAGE_SIZE;
+			scan->address += PAGE_SIZE;
 			cond_resched();
 		}
 	}
 
 	if (ksm_test_exit(mm)) {
-		ksm_scan.address = 0;
-		ksm_scan.rmap_list = &slot->rmap_list;
+		scan->address = 0;
+		scan->rmap_list = &slot->rmap_list;
 	}
 	/*
 	 * Nuke all the rmap_items that are above this current rmap:
 	 * because there were no VM_MERGEABLE vmas with such addresses.
 	 */
-	remove_trailing_rmap_items(slot, ksm_scan.rmap_list);
+	remove_trailing_rmap_items(slot, scan->rmap_list);
 
 	spin_lock(&ksm_mmlist_lock);
-	ksm_scan.mm_slot = list_entry(slot->mm_list.next,
+	scan->mm_slot = list_entry(slot->mm_list.next,
 						struct mm_slot, mm_list);
-	if (ksm_scan.address == 0) {
+	if (scan->address == 0) {
 		/*
 		 * We've completed a full scan of all vmas, holding mmap_sem
 		 * throughout, and found no VM_MERGEABLE: so do the same as
@@ -1388,6 +1552,8 @@ next_mm:
 		free_mm_slot(slot);
 		clear_bit(MMF_VM_MERGEABLE, &mm->flags);
 		up_read(&mm->mmap_sem);
+		/* No rmap_item may point to the mm once it can be freed */
+		free_stale_rmap_items(worker);
 		mmdrop(mm);
 	} else {
 		spin_unlock(&ksm_mmlist_lock);
@@ -1395,63 +1561,103 @@ next_mm:
 	}
 
 	/* Repeat until we've completed scanning the whole list */
-	slot = ksm_scan.mm_slot;
-	if (slot != &ksm_mm_head)
+	slot = scan->mm_slot;
+	if (slot != &worker->mm_head)
 		goto next_mm;
 
-	ksm_scan.seqnr++;
+	free_stale_rmap_items(worker);
+	ksm_worker_done(worker);
 	return NULL;
 }
 
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
+ * @worker - the ksmd thread scanning.
  * @scan_npages - number of pages we want to scan before we return.
  */
-static void ksm_do_scan(unsigned int scan_npages)
+static void ksm_do_scan(struct ksm_worker *worker, unsigned int scan_npages)
 {
 	struct rmap_item *rmap_item;
 	struct page *uninitialized_var(page);
+	unsigned int checksum;
 
 	while (scan_npages-- && likely(!freezing(current))) {
 		cond_resched();
-		rmap_item = scan_get_next_rmap_item(&page);
+		rmap_item = scan_get_next_rmap_item(worker, &page);
+		free_stale_rmap_items(worker);
 		if (!rmap_item)
 			return;
-		if (!PageKsm(page) || !in_stable_tree(rmap_item))
-			cmp_and_merge_page(page, rmap_item);
+		worker->pages_scanned++;
+		if (!PageKsm(page) || !in_stable_tree(rmap_item)) {
+			checksum = calc_checksum(page);
+			mutex_lock(&ksm_tree_mutex);
+			cmp_and_merge_page(worker, page, rmap_item, checksum);
+			mutex_unlock(&ksm_tree_mutex);
+		}
 		put_page(page);
 	}
 }
 
-static int ksmd_should_run(void)
+static int ksm_has_mm_slots(void)
 {
-	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
+	int i;
+
+	for (i = 0; i < ksm_nr_workers; i++)
+		if (!list_empty(&ksm_workers[i].mm_head.mm_list))
+			return 1;
+	return 0;
 }
 
-static int ksm_scan_thread(void *nothing)
+static int ksmd_should_run(struct ksm_worker *worker)
 {
+	return (ksm_run & KSM_RUN_MERGE) && worker->id < ksm_nr_workers &&
+		!worker->done && ksm_has_mm_slots();
+}
+
+static int ksm_scan_thread(void *arg)
+{
+	struct ksm_worker *worker = arg;
+
 	set_freezable();
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
-		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
-		mutex_unlock(&ksm_thread_mutex);
+		down_read(&ksm_thread_sem);
+		if (ksmd_should_run(worker))
+			ksm_do_scan(worker, DIV_ROUND_UP(ksm_thread_pages_to_scan,
+							 ksm_nr_workers));
+		up_read(&ksm_thread_sem);
 
 		try_to_freeze();
 
-		if (ksmd_should_run()) {
+		if (ksmd_should_run(worker)) {
 			schedule_timeout_interruptible(
 				msecs_to_jiffies(ksm_thread_sleep_millisecs));
 		} else {
 			wait_event_freezable(ksm_thread_wait,
-				ksmd_should_run() || kthread_should_stop());
+				ksmd_should_run(worker) ||
+				kthread_should_stop());
 		}
 	}
 	return 0;
 }
 
+static int ksm_start_worker(struct ksm_worker *worker)
+{
+	struct task_struct *thread;
+
+	if (worker->id)
+		thread = kthread_run(ksm_scan_thread, worker, "ksmd/%d",
+				     worker->id);
+	else
+		thread = kthread_run(ksm_scan_thread, worker, "ksmd");
+	if (IS_ERR(thread))
+		return PTR_ERR(thread);
+
+	worker->thread = thread;
+	return 0;
+}
+
 int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags)
 {
@@ -1497,6 +1703,7 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 
 int __ksm_enter(struct mm_struct *mm)
 {
+	struct ksm_worker *worker;
 	struct mm_slot *mm_slot;
 	int needs_wakeup;
 
@@ -1504,17 +1711,23 @@ int __ksm_enter(struct mm_struct *mm)
 	if (!mm_slot)
 		return -ENOMEM;
 
+	spin_lock(&ksm_mmlist_lock);
 	/* Check ksm_run too?  Would need tighter locking */
-	needs_wakeup = list_empty(&ksm_mm_head.mm_list);
+	needs_wakeup = !ksm_has_mm_slots();
+
+	/* Deal the mms out to the ksmd threads in turn */
+	worker = &ksm_workers[ksm_next_worker];
+	if (++ksm_next_worker >= ksm_nr_workers)
+		ksm_next_worker = 0;
 
-	spin_lock(&ksm_mmlist_lock);
 	insert_to_mm_slots_hash(mm, mm_slot);
+	mm_slot->worker = worker;
 	/*
 	 * Insert just behind the scanning cursor, to let the area settle
 	 * down a little; when fork is followed by immediate exec, we don't
 	 * want ksmd to waste time setting up and tearing down an rmap_list.
 	 */
-	list_add_tail(&mm_slot->mm_list, &ksm_scan.mm_slot->mm_list);
+	list_add_tail(&mm_slot->mm_list, &worker->scan.mm_slot->mm_list);
 	spin_unlock(&ksm_mmlist_lock);
 
 	set_bit(MMF_VM_MERGEABLE, &mm->flags);
@@ -1542,14 +1755,14 @@ void __ksm_exit(struct mm_struct *mm)
 
 	spin_lock(&ksm_mmlist_lock);
 	mm_slot = get_mm_slot(mm);
-	if (mm_slot && ksm_scan.mm_slot != mm_slot) {
+	if (mm_slot && mm_slot->worker->scan.mm_slot != mm_slot) {
 		if (!mm_slot->rmap_list) {
 			hlist_del(&mm_slot->link);
 			list_del(&mm_slot->mm_list);
 			easy_to_free = 1;
 		} else {
 			list_move(&mm_slot->mm_list,
-				  &ksm_scan.mm_slot->mm_list);
+				  &mm_slot->worker->scan.mm_slot->mm_list);
 		}
 	}
 	spin_unlock(&ksm_mmlist_lock);
@@ -1787,13 +2000,13 @@ static int ksm_memory_callback(struct notifier_block *self,
 		/*
 		 * Keep it very simple for now: just lock out ksmd and
 		 * MADV_UNMERGEABLE while any memory is going offline.
-		 * mutex_lock_nested() is necessary because lockdep was alarmed
-		 * that here we take ksm_thread_mutex inside notifier chain
+		 * down_write_nested() is necessary because lockdep was alarmed
+		 * that here we take ksm_thread_sem inside notifier chain
 		 * mutex, and later take notifier chain mutex inside
-		 * ksm_thread_mutex to unlock it.   But that's safe because both
+		 * ksm_thread_sem to unlock it.   But that's safe because both
 		 * are inside mem_hotplug_mutex.
 		 */
-		mutex_lock_nested(&ksm_thread_mutex, SINGLE_DEPTH_NESTING);
+		down_write_nested(&ksm_thread_sem, SINGLE_DEPTH_NESTING);
 		break;
 
 	case MEM_OFFLINE:
@@ -1808,7 +2021,7 @@ static int ksm_memory_callback(struct notifier_block *self,
 		/* fallthrough */
 
 	case MEM_CANCEL_OFFLINE:
-		mutex_unlock(&ksm_thread_mutex);
+		up_write(&ksm_thread_sem);
 		break;
 	}
 	return NOTIFY_OK;
@@ -1897,7 +2110,7 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 	 * on the list for when ksmd may be set running again).
 	 */
 
-	mutex_lock(&ksm_thread_mutex);
+	down_write(&ksm_thread_sem);
 	if (ksm_run != flags) {
 		ksm_run = flags;
 		if (flags & KSM_RUN_UNMERGE) {
@@ -1912,7 +2125,7 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 			}
 		}
 	}
-	mutex_unlock(&ksm_thread_mutex);
+	up_write(&ksm_thread_sem);
 
 	if (flags & KSM_RUN_MERGE)
 		wake_up_interruptible(&ksm_thread_wait);
@@ -1947,7 +2160,8 @@ static ssize_t pages_volatile_show(struct kobject *kobj,
 {
 	long ksm_pages_volatile;
 
-	ksm_pages_volatile = ksm_rmap_items - ksm_pages_shared
+	ksm_pages_volatile = atomic_long_read(&ksm_rmap_items)
+				- ksm_pages_shared
 				- ksm_pages_sharing - ksm_pages_unshared;
 	/*
 	 * It was not worth any locking to calculate that statistic,
@@ -1962,10 +2176,85 @@ KSM_ATTR_RO(pages_volatile);
 static ssize_t full_scans_show(struct kobject *kobj,
 			       struct kobj_attribute *attr, char *buf)
 {
-	return sprintf(buf, "%lu\n", ksm_scan.seqnr);
+	return sprintf(buf, "%lu\n", ksm_seqnr);
 }
 KSM_ATTR_RO(full_scans);
 
+/*
+ * Called with ksm_thread_sem held for write.  The mm_slots of threads
+ * going idle are dealt out to the ones staying, and the round restarts
+ * on the new split.
+ */
+static void ksm_set_nr_workers(int nr)
+{
+	struct ksm_worker *from, *to;
+	struct mm_slot *mm_slot;
+	int i;
+
+	spin_lock(&ksm_mmlist_lock);
+	for (i = nr; i < ksm_nr_workers; i++) {
+		from = &ksm_workers[i];
+		to = &ksm_workers[i % nr];
+		list_for_each_entry(mm_slot, &from->mm_head.mm_list, mm_list)
+			mm_slot->worker = to;
+		list_splice_tail_init(&from->mm_head.mm_list,
+				      &to->mm_head.mm_list);
+		from->scan.mm_slot = &from->mm_head;
+	}
+	ksm_nr_workers = nr;
+	ksm_next_worker = 0;
+	spin_unlock(&ksm_mmlist_lock);
+
+	ksm_restart_scan();
+}
+
+static ssize_t scan_threads_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", ksm_nr_workers);
+}
+
+static ssize_t scan_threads_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	unsigned long nr;
+	int err, i;
+
+	err = strict_strtoul(buf, 10, &nr);
+	if (err || nr < 1 || nr > KSM_MAX_WORKERS)
+		return -EINVAL;
+
+	down_write(&ksm_thread_sem);
+	for (i = 0; i < nr && !err; i++)
+		if (!ksm_workers[i].thread)
+			err = ksm_start_worker(&ksm_workers[i]);
+	if (!err && nr != ksm_nr_workers)
+		ksm_set_nr_workers(nr);
+	up_write(&ksm_thread_sem);
+
+	wake_up_interruptible(&ksm_thread_wait);
+
+	return err ? err : count;
+}
+KSM_ATTR(scan_threads);
+
+static ssize_t worker_stats_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	struct ksm_worker *worker;
+	ssize_t n = 0;
+	int i;
+
+	for (i = 0; i < ksm_nr_workers; i++) {
+		worker = &ksm_workers[i];
+		n += sprintf(buf + n, "%d %lu %lu\n", i,
+			     worker->pages_scanned, worker->pages_merged);
+	}
+	return n;
+}
+KSM_ATTR_RO(worker_stats);
+
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
@@ -1975,6 +2264,8 @@ static struct attribute *ksm_attrs[] = {
 	&pages_unshared_attr.attr,
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
+	&scan_threads_attr.attr,
+	&worker_stats_attr.attr,
 	NULL,
 };
 
@@ -1986,17 +2277,23 @@ static struct attribute_group ksm_attr_group = {
 
 static int __init ksm_init(void)
 {
-	struct task_struct *ksm_thread;
-	int err;
+	struct ksm_worker *worker;
+	int i, err;
+
+	for (i = 0; i < KSM_MAX_WORKERS; i++) {
+		worker = &ksm_workers[i];
+		INIT_LIST_HEAD(&worker->mm_head.mm_list);
+		worker->scan.mm_slot = &worker->mm_head;
+		worker->id = i;
+	}
 
 	err = ksm_slab_init();
 	if (err)
 		goto out;
 
-	ksm_thread = kthread_run(ksm_scan_thread, NULL, "ksmd");
-	if (IS_ERR(ksm_thread)) {
+	err = ksm_start_worker(&ksm_workers[0]);
+	if (err) {
 		printk(KERN_ERR "ksm: creating kthread failed\n");
-		err = PTR_ERR(ksm_thread);
 		goto out_free;
 	}
 
@@ -2004,7 +2301,7 @@ static int __init ksm_init(void)
 	err = sysfs_create_group(mm_kobj, &ksm_attr_group);
 	if (err) {
 		printk(KERN_ERR "ksm: register sysfs failed\n");
-		kthread_stop(ksm_thread);
+		kthread_stop(ksm_workers[0].thread);
 		goto out_free;
 	}
 #else
@@ -2014,7 +2311,7 @@ static int __init ksm_init(void)
 
 #ifdef CONFIG_MEMORY_HOTREMOVE
 	/*
-	 * Choose a high priority since the callback takes ksm_thread_mutex:
+	 * Choose a high priority since the callback takes ksm_thread_sem:
 	 * later callbacks could only be taking locks which nest within that.
 	 */
 	hotplug_memory_notifier(ksm_memory_callback, 100);
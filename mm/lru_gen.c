@@ -0,0 +1,443 @@
+/*
+ *  mm/lru_gen.c - multi-generational page aging for reclaim
+ *
+ *  The classic reclaim scanner asks the reverse map of every mapped
+ *  page it looks at whether one of its ptes has been referenced.  For
+ *  a page mapped by many processes that is a walk over every vma that
+ *  could map it, repeated each time the page comes around the list,
+ *  and pages are only ever "referenced" or "not referenced".
+ *
+ *  This file turns that around.  Every now and then reclaim starts an
+ *  aging pass that increments a global sequence number (max_seq) and
+ *  walks the page tables of all user address spaces, clearing the
+ *  accessed bits in bulk with a single TLB flush per mm.  A page that
+ *  was accessed since the previous pass is stamped with the new
+ *  sequence number; the others keep their old one.  The age of a
+ *  mapped page, max_seq minus its own sequence number, is then all
+ *  the scanner needs to decide whether to activate, keep or evict it:
+ *  no rmap walk, and MAX_NR_GENS levels of coldness instead of one.
+ *
+ *  The sequence number is kept modulo LRU_GEN_SEQS in LRU_GEN_WIDTH
+ *  bits of page->flags, 0 meaning "not seen by an aging pass yet".
+ *  Pages that the walk finds idle for MAX_NR_GENS - 1 passes are
+ *  clamped at that age so that the counter cannot wrap around.
+ *
+ *  Reclaim on behalf of a memory cgroup and pages without a mapping
+ *  keep using the classic active/inactive logic.
+ */
+
+#include <linux/mm.h>
+#include <linux/swap.h>
+#include <linux/mm_inline.h>
+#include <linux/sched.h>
+#include <linux/hugetlb.h>
+#include <linux/mmzone.h>
+#include <linux/lru_gen.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/jiffies.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/init.h>
+#include <asm/tlbflush.h>
+
+#define LRU_GEN_SEQS	((1 << LRU_GEN_WIDTH) - 1)
+
+int lru_gen_enabled __read_mostly;
+static unsigned int lru_gen_aging_interval_ms __read_mostly = 1000;
+
+static unsigned long lru_gen_max_seq = MAX_NR_GENS;
+static unsigned long lru_gen_last_aging;	/* jiffies */
+static DEFINE_MUTEX(lru_gen_aging_mutex);
+
+/* Statistics of the aging passes, shown in debugfs */
+static unsigned long lru_gen_nr_passes;
+static unsigned long lru_gen_mms_walked;
+static unsigned long lru_gen_mms_skipped;
+static u64 lru_gen_last_pass_ns;
+
+/* All user address spaces, in order of creation */
+static LIST_HEAD(lru_gen_mm_list);
+static DEFINE_SPINLOCK(lru_gen_mm_lock);
+
+struct lru_gen_walk {
+	struct vm_area_struct *vma;
+	unsigned long seq;
+	int flush;
+};
+
+void lru_gen_add_mm(struct mm_struct *mm)
+{
+	spin_lock(&lru_gen_mm_lock);
+	list_add_tail(&mm->lru_gen_list, &lru_gen_mm_list);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+void lru_gen_del_mm(struct mm_struct *mm)
+{
+	spin_lock(&lru_gen_mm_lock);
+	list_del(&mm->lru_gen_list);
+	spin_unlock(&lru_gen_mm_lock);
+}
+
+static inline unsigned long page_lru_gen(struct page *page)
+{
+	return (page->flags & LRU_GEN_MASK) >> LRU_GEN_PGOFF;
+}
+
+/*
+ * page->flags is updated with atomic bitops by everybody else, so
+ * the generation field has to be replaced in a cmpxchg loop.  Returns
+ * true if the generation changed.
+ */
+static bool set_page_lru_gen(struct page *page, unsigned long seq)
+{
+	unsigned long old, new;
+	unsigned long gen = seq % LRU_GEN_SEQS + 1;
+
+	do {
+		old = ACCESS_ONCE(page->flags);
+		new = (old & ~LRU_GEN_MASK) | (gen << LRU_GEN_PGOFF);
+		if (old == new)
+			return false;
+	} while (cmpxchg(&page->flags, old, new) != old);
+
+	return true;
+}
+
+static inline int lru_gen_age(unsigned long gen, unsigned long seq)
+{
+	return (seq % LRU_GEN_SEQS + LRU_GEN_SEQS - (gen - 1)) % LRU_GEN_SEQS;
+}
+
+/*
+ * Called for pages going onto the LRU lists: they are about to be
+ * used, so they start out in the youngest generation.
+ */
+void lru_gen_init_page(struct page *page)
+{
+	set_page_lru_gen(page, ACCESS_ONCE(lru_gen_max_seq));
+}
+
+/*
+ * Returns the age of a mapped page in aging passes, between 0 and
+ * MAX_NR_GENS - 1, or -1 if the page has to be checked through the
+ * reverse map instead.
+ */
+int lru_gen_page_age(struct page *page)
+{
+	unsigned long gen;
+	int age;
+
+	if (!lru_gen_enabled || !page_mapped(page))
+		return -1;
+
+	gen = page_lru_gen(page);
+	if (!gen)
+		return -1;
+
+	age = lru_gen_age(gen, ACCESS_ONCE(lru_gen_max_seq));
+	return min(age, MAX_NR_GENS - 1);
+}
+
+static void lru_gen_age_page(struct page *page, int young,
+			     struct lru_gen_walk *args)
+{
+	unsigned long gen = page_lru_gen(page);
+	int age = MAX_NR_GENS - 1;
+
+	if (young) {
+		age = 0;
+		args->flush = 1;
+	} else if (gen) {
+		age = min(lru_gen_age(gen, args->seq), MAX_NR_GENS - 1);
+	}
+
+	if (age != 0 && age != MAX_NR_GENS - 1)
+		return;
+
+	/* a page mapped several times is only counted once */
+	if (set_page_lru_gen(page, args->seq - age))
+		page_zone(page)->lru_gen_pages[!!age][page_is_file_cache(page)]
+			+= hpage_nr_pages(page);
+}
+
+static int lru_gen_pmd_entry(pmd_t *pmd, unsigned long addr,
+			     unsigned long end, struct mm_walk *walk)
+{
+	struct lru_gen_walk *args = walk->private;
+	struct vm_area_struct *vma = args->vma;
+	struct page *page;
+	pte_t *pte;
+	spinlock_t *ptl;
+	int young;
+
+	spin_lock(&walk->mm->page_table_lock);
+	if (pmd_trans_huge(*pmd)) {
+		if (!pmd_trans_splitting(*pmd)) {
+			page = pmd_page(*pmd);
+			young = pmdp_test_and_clear_young(vma, addr, pmd);
+			lru_gen_age_page(page, young, args);
+		}
+		spin_unlock(&walk->mm->page_table_lock);
+		return 0;
+	}
+	spin_unlock(&walk->mm->page_table_lock);
+
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		if (!pte_present(*pte))
+			continue;
+
+		page = vm_normal_page(vma, addr, *pte);
+		if (!page || PageReserved(page) || !PageLRU(page))
+			continue;
+
+		young = ptep_test_and_clear_young(vma, addr, pte);
+		lru_gen_age_page(page, young, args);
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+	cond_resched();
+	return 0;
+}
+
+static void lru_gen_walk_mm(struct mm_struct *mm, struct lru_gen_walk *args)
+{
+	struct vm_area_struct *vma;
+	struct mm_walk walk = {
+		.pmd_entry = lru_gen_pmd_entry,
+		.mm = mm,
+		.private = args,
+	};
+
+	/* Never wait for a writer: it may be waiting for our reclaim */
+	if (!down_read_trylock(&mm->mmap_sem)) {
+		lru_gen_mms_skipped++;
+		return;
+	}
+
+	args->flush = 0;
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		if (is_vm_hugetlb_page(vma) ||
+		    (vma->vm_flags & (VM_IO | VM_PFNMAP | VM_LOCKED)))
+			continue;
+		args->vma = vma;
+		walk_page_range(vma->vm_start, vma->vm_end, &walk);
+	}
+	if (args->flush)
+		flush_tlb_mm(mm);
+	up_read(&mm->mmap_sem);
+	lru_gen_mms_walked++;
+}
+
+/*
+ * One aging pass: open a new generation and walk all address spaces.
+ * The mm being walked is pinned through mm_users, which also keeps
+ * it on lru_gen_mm_list so the walk can continue from it afterwards.
+ */
+static void lru_gen_age_all(void)
+{
+	struct lru_gen_walk args;
+	struct mm_struct *mm, *prev = NULL;
+	struct list_head *pos;
+	struct zone *zone;
+	u64 start = local_clock();
+
+	for_each_populated_zone(zone)
+		memset(zone->lru_gen_pages, 0, sizeof(zone->lru_gen_pages));
+
+	args.seq = lru_gen_max_seq + 1;
+	ACCESS_ONCE(lru_gen_max_seq) = args.seq;
+	lru_gen_mms_walked = lru_gen_mms_skipped = 0;
+
+	spin_lock(&lru_gen_mm_lock);
+	for (pos = lru_gen_mm_list.next; pos != &lru_gen_mm_list;
+	     pos = pos->next) {
+		mm = list_entry(pos, struct mm_struct, lru_gen_list);
+		if (!atomic_inc_not_zero(&mm->mm_users))
+			continue;
+		spin_unlock(&lru_gen_mm_lock);
+
+		if (prev)
+			mmput(prev);
+		lru_gen_walk_mm(mm, &args);
+		prev = mm;
+
+		spin_lock(&lru_gen_mm_lock);
+	}
+	spin_unlock(&lru_gen_mm_lock);
+	if (prev)
+		mmput(prev);
+
+	lru_gen_nr_passes++;
+	lru_gen_last_pass_ns = local_clock() - start;
+}
+
+/**
+ * lru_gen_maybe_age - run an aging pass if the last one is old enough
+ * @force: reclaim is struggling, age even before the interval is up
+ *
+ * Called from reclaim.  At most one pass runs at a time, concurrent
+ * reclaimers carry on with the ages of the previous pass.
+ */
+void lru_gen_maybe_age(int force)
+{
+	unsigned long interval;
+
+	if (!lru_gen_enabled)
+		return;
+
+	interval = msecs_to_jiffies(lru_gen_aging_interval_ms);
+	if (force)
+		interval /= 4;
+	if (lru_gen_nr_passes &&
+	    time_before(jiffies, lru_gen_last_aging + interval))
+		return;
+
+	if (!mutex_trylock(&lru_gen_aging_mutex))
+		return;
+	if (!lru_gen_nr_passes ||
+	    !time_before(jiffies, lru_gen_last_aging + interval)) {
+		lru_gen_age_all();
+		lru_gen_last_aging = jiffies;
+	}
+	mutex_unlock(&lru_gen_aging_mutex);
+}
+
+#ifdef CONFIG_SYSFS
+/* see Documentation/vm/multigen_lru.txt */
+
+#define LRU_GEN_ATTR(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static ssize_t enabled_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", lru_gen_enabled);
+}
+
+static ssize_t enabled_store(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	unsigned long flags;
+	int err;
+
+	err = strict_strtoul(buf, 10, &flags);
+	if (err || flags > 1)
+		return -EINVAL;
+
+	lru_gen_enabled = flags;
+
+	return count;
+}
+LRU_GEN_ATTR(enabled);
+
+static ssize_t aging_interval_ms_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", lru_gen_aging_interval_ms);
+}
+
+static ssize_t aging_interval_ms_store(struct kobject *kobj,
+				       struct kobj_attribute *attr,
+				       const char *buf, size_t count)
+{
+	unsigned long msecs;
+	int err;
+
+	err = strict_strtoul(buf, 10, &msecs);
+	if (err || msecs > UINT_MAX)
+		return -EINVAL;
+
+	lru_gen_aging_interval_ms = msecs;
+
+	return count;
+}
+LRU_GEN_ATTR(aging_interval_ms);
+
+static struct attribute *lru_gen_attrs[] = {
+	&enabled_attr.attr,
+	&aging_interval_ms_attr.attr,
+	NULL,
+};
+
+static struct attribute_group lru_gen_attr_group = {
+	.attrs = lru_gen_attrs,
+	.name = "lru_gen",
+};
+#endif /* CONFIG_SYSFS */
+
+#ifdef CONFIG_DEBUG_FS
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+static int lru_gen_debug_show(struct seq_file *m, void *v)
+{
+	struct zone *zone;
+	unsigned long seq;
+	int i;
+
+	mutex_lock(&lru_gen_aging_mutex);
+	seq = lru_gen_max_seq;
+	seq_printf(m,
+		   "max_seq:          %8lu\n"
+		   "passes:           %8lu\n"
+		   "last_aging_ms:    %8u\n"
+		   "last_pass_us:     %8llu\n"
+		   "mms_walked:       %8lu\n"
+		   "mms_skipped:      %8lu\n",
+		   seq, lru_gen_nr_passes,
+		   lru_gen_nr_passes ?
+			jiffies_to_msecs(jiffies - lru_gen_last_aging) : 0,
+		   (unsigned long long)div_u64(lru_gen_last_pass_ns, 1000),
+		   lru_gen_mms_walked, lru_gen_mms_skipped);
+
+	for_each_populated_zone(zone) {
+		seq_printf(m, "node %d zone %s\n",
+			   zone_to_nid(zone), zone->name);
+		seq_printf(m, "  gen      seq       anon       file\n");
+		for (i = 0; i < 2; i++)
+			seq_printf(m, "  %3d %8lu %10lu %10lu\n",
+				   i * (MAX_NR_GENS - 1),
+				   seq - i * (MAX_NR_GENS - 1),
+				   zone->lru_gen_pages[i][0],
+				   zone->lru_gen_pages[i][1]);
+	}
+	mutex_unlock(&lru_gen_aging_mutex);
+
+	return 0;
+}
+
+static int lru_gen_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lru_gen_debug_show, NULL);
+}
+
+static const struct file_operations lru_gen_debug_fops = {
+	.open		= lru_gen_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif /* CONFIG_DEBUG_FS */
+
+static int __init lru_gen_init(void)
+{
+	int err = 0;
+
+#ifdef CONFIG_DEBUG_FS
+	debugfs_create_file("lru_gen", 0444, NULL, NULL, &lru_gen_debug_fops);
+#endif
+#ifdef CONFIG_SYSFS
+	err = sysfs_create_group(mm_kobj, &lru_gen_attr_group);
+	if (err)
+		printk(KERN_ERR "lru_gen: register sysfs failed\n");
+#endif
+	return err;
+}
+module_init(lru_gen_init)
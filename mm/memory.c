@@ -57,6 +57,7 @@
 #include <linux/swapops.h>
 #include <linux/elf.h>
 #include <linux/gfp.h>
+#include <linux/file.h>
 
 #include <asm/io.h>
 #include <asm/pgalloc.h>
@@ -2933,6 +2934,12 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	int exclusive = 0;
 	int ret = 0;
 
+	/* pte_unmap_same() does not revalidate the page table */
+	if (flags & FAULT_FLAG_SPECULATIVE) {
+		pte_unmap(page_table);
+		return VM_FAULT_RETRY;
+	}
+
 	if (!pte_unmap_same(mm, pmd, page_table, orig_pte))
 		goto out;
 
@@ -2952,8 +2959,8 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	page = lookup_swap_cache(entry);
 	if (!page) {
 		grab_swap_token(mm); /* Contend for token _before_ read-in */
-		page = swapin_readahead(entry,
-					GFP_HIGHUSER_MOVABLE, vma, address);
+		page = swap_vma_readahead(entry,
+					GFP_HIGHUSER_MOVABLE, vma, address, pmd);
 		if (!page) {
 			/*
 			 * Back out if somebody else faulted in this pte
@@ -3132,6 +3139,143 @@ static inline int check_stack_guard_page(struct vm_area_struct *vma, unsigned lo
 	return 0;
 }
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Speculative page faults run without mmap_sem, on a private copy of
+ * the vma.  SPECULATIVE_PAGE_FAULT is only offered on UP: with preemption
+ * disabled no mmap_sem writer can run, and the sequence counts tell us
+ * whether one was preempted half way through an update.  Everything the
+ * fault decided on the copy is checked again under the page table lock
+ * before a pte is installed, so a racing munmap or mprotect either sees
+ * our pte or makes us redo the fault under mmap_sem.
+ */
+
+/* Find the vma covering @address, or NULL.  Called with preemption off. */
+static struct vm_area_struct *spf_find_vma(struct mm_struct *mm,
+					   unsigned long address)
+{
+	struct vm_area_struct *vma = NULL;
+	struct rb_node *rb_node;
+	unsigned seq;
+
+	seq = raw_read_seqcount(&mm->mm_rb_seq);
+	if (seq & 1)
+		return NULL;
+
+	rb_node = mm->mm_rb.rb_node;
+	while (rb_node) {
+		struct vm_area_struct *tmp;
+
+		tmp = rb_entry(rb_node, struct vm_area_struct, vm_rb);
+		if (tmp->vm_end > address) {
+			if (tmp->vm_start <= address) {
+				vma = tmp;
+				break;
+			}
+			rb_node = rb_node->rb_left;
+		} else
+			rb_node = rb_node->rb_right;
+	}
+
+	if (read_seqcount_retry(&mm->mm_rb_seq, seq))
+		return NULL;
+	return vma;
+}
+
+/* Find the pmd mapping @address without allocating.  Preemption off. */
+static pmd_t *spf_walk_pmd(struct mm_struct *mm, unsigned long address)
+{
+	pgd_t *pgd;
+	pud_t *pud;
+	pmd_t *pmd;
+
+	pgd = pgd_offset(mm, address);
+	if (pgd_none(*pgd) || unlikely(pgd_bad(*pgd)))
+		return NULL;
+	pud = pud_offset(pgd, address);
+	if (pud_none(*pud) || unlikely(pud_bad(*pud)))
+		return NULL;
+	pmd = pmd_offset(pud, address);
+	if (pmd_none(*pmd) || pmd_trans_huge(*pmd) || unlikely(pmd_bad(*pmd)))
+		return NULL;
+	return pmd;
+}
+
+/*
+ * Is the vma that @vma was copied from still mapped, unchanged, at
+ * @address?  A vma freed and reallocated in between must also match
+ * field for field to pass, in which case the copy is as good as new.
+ */
+static bool spf_vma_unchanged(struct vm_area_struct *vma,
+			      unsigned long address)
+{
+	struct vm_area_struct *cur = spf_find_vma(vma->vm_mm, address);
+
+	return cur &&
+	       cur->vm_sequence.sequence == vma->vm_sequence.sequence &&
+	       cur->vm_start == vma->vm_start &&
+	       cur->vm_end == vma->vm_end &&
+	       cur->vm_flags == vma->vm_flags &&
+	       pgprot_val(cur->vm_page_prot) == pgprot_val(vma->vm_page_prot) &&
+	       cur->vm_pgoff == vma->vm_pgoff &&
+	       cur->vm_file == vma->vm_file &&
+	       cur->vm_ops == vma->vm_ops &&
+	       cur->anon_vma == vma->anon_vma;
+}
+
+/*
+ * Map and lock the pte for @address.  For a speculative fault, returns
+ * NULL if the vma or the page table changed since the fault started.
+ */
+static pte_t *pte_map_lock(struct mm_struct *mm, struct vm_area_struct *vma,
+			   pmd_t *pmd, unsigned long address,
+			   unsigned int flags, spinlock_t **ptlp)
+{
+	pte_t *pte = NULL;
+
+	if (!(flags & FAULT_FLAG_SPECULATIVE))
+		return pte_offset_map_lock(mm, pmd, address, ptlp);
+
+	preempt_disable();
+	if (spf_vma_unchanged(vma, address) &&
+	    spf_walk_pmd(mm, address) == pmd)
+		pte = pte_offset_map_lock(mm, pmd, address, ptlp);
+	preempt_enable();
+	return pte;
+}
+
+/*
+ * Only the simple faults are handled speculatively: a private anonymous
+ * vma that already has its anon_vma (or a read, which maps the zero
+ * page), or a page cache vma using filemap_fault() that will not need
+ * ->page_mkwrite.  Stack expansion, anon_vma allocation, hugetlb and
+ * driver mappings all want mmap_sem and go the slow way.
+ */
+static bool spf_vma_eligible(struct vm_area_struct *vma, unsigned int flags)
+{
+	if (vma->vm_flags & (VM_SPECIAL | VM_MIXEDMAP | VM_HUGETLB |
+			     VM_NONLINEAR | VM_GROWSDOWN | VM_GROWSUP))
+		return false;
+
+	if (!vma->vm_ops)
+		return vma->anon_vma || !(flags & FAULT_FLAG_WRITE);
+
+	if (vma->vm_ops->fault != filemap_fault)
+		return false;
+	if (flags & FAULT_FLAG_WRITE)
+		return !(vma->vm_flags & VM_SHARED) && vma->anon_vma;
+	return true;
+}
+#else
+static inline pte_t *pte_map_lock(struct mm_struct *mm,
+			struct vm_area_struct *vma, pmd_t *pmd,
+			unsigned long address, unsigned int flags,
+			spinlock_t **ptlp)
+{
+	return pte_offset_map_lock(mm, pmd, address, ptlp);
+}
+#endif /* CONFIG_SPECULATIVE_PAGE_FAULT */
+
 /*
  * We enter with non-exclusive mmap_sem (to exclude vma changes,
  * but allow concurrent faults), and pte mapped but not yet locked.
@@ -3155,7 +3299,9 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	if (!(flags & FAULT_FLAG_WRITE)) {
 		entry = pte_mkspecial(pfn_pte(my_zero_pfn(address),
 						vma->vm_page_prot));
-		page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
+		page_table = pte_map_lock(mm, vma, pmd, address, flags, &ptl);
+		if (!page_table)
+			return VM_FAULT_RETRY;
 		if (!pte_none(*page_table))
 			goto unlock;
 		goto setpte;
@@ -3176,7 +3322,12 @@ static int do_anonymous_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	if (vma->vm_flags & VM_WRITE)
 		entry = pte_mkwrite(pte_mkdirty(entry));
 
-	page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
+	page_table = pte_map_lock(mm, vma, pmd, address, flags, &ptl);
+	if (!page_table) {
+		mem_cgroup_uncharge_page(page);
+		page_cache_release(page);
+		return VM_FAULT_RETRY;
+	}
 	if (!pte_none(*page_table))
 		goto release;
 
@@ -3310,7 +3461,17 @@ static int __do_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 
 	}
 
-	page_table = pte_offset_map_lock(mm, pmd, address, &ptl);
+	page_table = pte_map_lock(mm, vma, pmd, address, flags, &ptl);
+	if (unlikely(!page_table)) {
+		if (charged)
+			mem_cgroup_uncharge_page(page);
+		if (anon)
+			page_cache_release(page);
+		else
+			anon = 1; /* no anon but release faulted_page */
+		ret = VM_FAULT_RETRY;
+		goto out;
+	}
 
 	/*
 	 * This silly early PAGE_DIRTY setting removes a race
@@ -3414,6 +3575,12 @@ static int do_nonlinear_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 
 	flags |= FAULT_FLAG_NONLINEAR;
 
+	/* pte_unmap_same() does not revalidate the page table */
+	if (flags & FAULT_FLAG_SPECULATIVE) {
+		pte_unmap(page_table);
+		return VM_FAULT_RETRY;
+	}
+
 	if (!pte_unmap_same(mm, pmd, page_table, orig_pte))
 		return 0;
 
@@ -3441,15 +3608,19 @@ static int do_nonlinear_fault(struct mm_struct *mm, struct vm_area_struct *vma,
  * We enter with non-exclusive mmap_sem (to exclude vma changes,
  * but allow concurrent faults), and pte mapped but not yet locked.
  * We return with mmap_sem still held, but pte unmapped and unlocked.
+ *
+ * @entry is the value of *pte the fault was decided on.  Speculative
+ * faults pass the snapshot taken while the page table was pinned: by
+ * the time we get here it may have been freed, so *pte must only be
+ * read again once pte_map_lock() has revalidated it.
  */
-int handle_pte_fault(struct mm_struct *mm,
-		     struct vm_area_struct *vma, unsigned long address,
-		     pte_t *pte, pmd_t *pmd, unsigned int flags)
+static int __handle_pte_fault(struct mm_struct *mm,
+			      struct vm_area_struct *vma, unsigned long address,
+			      pte_t *pte, pmd_t *pmd, unsigned int flags,
+			      pte_t entry)
 {
-	pte_t entry;
 	spinlock_t *ptl;
 
-	entry = *pte;
 	if (!pte_present(entry)) {
 		if (pte_none(entry)) {
 			if (vma->vm_ops) {
@@ -3467,8 +3638,15 @@ int handle_pte_fault(struct mm_struct *mm,
 					pte, pmd, flags, entry);
 	}
 
-	ptl = pte_lockptr(mm, pmd);
-	spin_lock(ptl);
+	if (flags & FAULT_FLAG_SPECULATIVE) {
+		pte_unmap(pte);
+		pte = pte_map_lock(mm, vma, pmd, address, flags, &ptl);
+		if (!pte)
+			return VM_FAULT_RETRY;
+	} else {
+		ptl = pte_lockptr(mm, pmd);
+		spin_lock(ptl);
+	}
 	if (unlikely(!pte_same(*pte, entry)))
 		goto unlock;
 	if (flags & FAULT_FLAG_WRITE) {
@@ -3495,6 +3673,13 @@ unlock:
 	return 0;
 }
 
+int handle_pte_fault(struct mm_struct *mm,
+		     struct vm_area_struct *vma, unsigned long address,
+		     pte_t *pte, pmd_t *pmd, unsigned int flags)
+{
+	return __handle_pte_fault(mm, vma, address, pte, pmd, flags, *pte);
+}
+
 /*
  * By the time we get here, we already hold the mm semaphore
  */
@@ -3549,6 +3734,10 @@ retry:
 					goto retry;
 				return ret;
 			}
+			if (!pmd_trans_splitting(orig_pmd))
+				huge_pmd_set_accessed(mm, vma, address, pmd,
+						      orig_pmd,
+						      flags & FAULT_FLAG_WRITE);
 			return 0;
 		}
 	}
@@ -3574,6 +3763,84 @@ retry:
 	return handle_pte_fault(mm, vma, address, pte, pmd, flags);
 }
 
+#ifdef CONFIG_SPECULATIVE_PAGE_FAULT
+/*
+ * Try to handle a fault at @address without taking mmap_sem.  The vma
+ * must allow one of the @vm_access permissions.  Returns VM_FAULT_RETRY
+ * if the fault has to be handled by handle_mm_fault() under mmap_sem:
+ * the vma is being changed, the fault is not one of the simple cases,
+ * or it failed and the error has to be worked out with the vma stable.
+ */
+int handle_speculative_fault(struct mm_struct *mm, unsigned long address,
+			     unsigned int flags, unsigned long vm_access)
+{
+	struct vm_area_struct *vma, copy;
+	pmd_t *pmd;
+	pte_t *pte, entry;
+	unsigned seq;
+	int ret;
+
+	__set_current_state(TASK_RUNNING);
+
+	count_vm_event(SPF_ATTEMPT);
+	flags |= FAULT_FLAG_SPECULATIVE;
+
+	preempt_disable();
+	vma = spf_find_vma(mm, address);
+	if (!vma)
+		goto out_abort;
+	seq = raw_read_seqcount(&vma->vm_sequence);
+	if (seq & 1)
+		goto out_abort;
+	copy = *vma;
+	if (read_seqcount_retry(&vma->vm_sequence, seq))
+		goto out_abort;
+
+	if (!(copy.vm_flags & vm_access) || !spf_vma_eligible(&copy, flags))
+		goto out_abort;
+
+	pmd = spf_walk_pmd(mm, address);
+	if (!pmd)
+		goto out_abort;
+	pte = pte_offset_map(pmd, address);
+	entry = *pte;
+	if (!pte_none(entry) &&
+	    (!pte_present(entry) ||
+	     ((flags & FAULT_FLAG_WRITE) && !pte_write(entry)))) {
+		pte_unmap(pte);
+		goto out_abort;
+	}
+
+	/*
+	 * The vma holds a reference on its file for as long as it is
+	 * mapped, and it cannot be unmapped while we are not preemptible.
+	 */
+	if (copy.vm_file)
+		get_file(copy.vm_file);
+	preempt_enable();
+
+	check_sync_rss_stat(current);
+	ret = __handle_pte_fault(mm, &copy, address, pte, pmd, flags, entry);
+
+	if (copy.vm_file)
+		fput(copy.vm_file);
+
+	if (unlikely(ret & (VM_FAULT_RETRY | VM_FAULT_ERROR))) {
+		count_vm_event(SPF_ABORT);
+		return VM_FAULT_RETRY;
+	}
+
+	count_vm_event(PGFAULT);
+	mem_cgroup_count_vm_event(mm, PGFAULT);
+	return ret;
+
+out_abort:
+	preempt_enable();
+	count_vm_event(SPF_ABORT);
+	return VM_FAULT_RETRY;
+}
+#endif /* CONFIG_SPECULATIVE_PAGE_FAULT */
+
 #ifndef __PAGETABLE_PUD_FOLDED
 /*
  * Allocate page upper directory.
@@ -81,29 +81,25 @@ void __init free_bootmem_late(unsigned long addr, unsigned long size)
 	}
 }
 
+/*
+ * Release the range in the largest naturally aligned blocks, up to
+ * MAX_ORDER - 1.  The zone boundaries of x86, the one user of this,
+ * are aligned to that.
+ */
 static void __init __free_pages_memory(unsigned long start, unsigned long end)
 {
-	unsigned long i, start_aligned, end_aligned;
-	int order = ilog2(BITS_PER_LONG);
-
-	start_aligned = (start + (BITS_PER_LONG - 1)) & ~(BITS_PER_LONG - 1);
-	end_aligned = end & ~(BITS_PER_LONG - 1);
+	unsigned long order;
 
-	if (end_aligned <= start_aligned) {
-		for (i = start; i < end; i++)
-			__free_pages_bootmem(pfn_to_page(i), 0);
+	while (start < end) {
+		order = MAX_ORDER - 1;
+		if (start)
+			order = min(order, __ffs(start));
+		while (start + (1UL << order) > end)
+			order--;
 
-		return;
+		__free_pages_bootmem(pfn_to_page(start), order);
+		start += 1UL << order;
 	}
-
-	for (i = start; i < start_aligned; i++)
-		__free_pages_bootmem(pfn_to_page(i), 0);
-
-	for (i = start_aligned; i < end_aligned; i += BITS_PER_LONG)
-		__free_pages_bootmem(pfn_to_page(i), order);
-
-	for (i = end_aligned; i < end; i++)
-		__free_pages_bootmem(pfn_to_page(i), 0);
 }
 
 unsigned long __init free_all_memory_core_early(int nodeid)
@@ -48,6 +48,7 @@
 #include <linux/backing-dev.h>
 #include <linux/fault-inject.h>
 #include <linux/page-isolation.h>
+#include <linux/migrate.h>
 #include <linux/page_cgroup.h>
 #include <linux/debugobjects.h>
 #include <linux/kmemleak.h>
@@ -57,6 +58,7 @@
 #include <linux/ftrace_event.h>
 #include <linux/memcontrol.h>
 #include <linux/prefetch.h>
+#include <linux/kthread.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -579,6 +581,77 @@ static inline int free_pages_check(struct page *page)
 	return 0;
 }
 
+/*
+ * The pcp batch grows up to PCP_BATCH_SCALE times its base size while
+ * zone->lock is contended and shrinks down to 1/PCP_BATCH_SCALE of it
+ * under memory pressure. After PCP_BATCH_DECAY bulk operations without
+ * either, it moves one step back towards the base size.
+ */
+#define PCP_BATCH_SCALE		4
+#define PCP_BATCH_DECAY		64
+
+/*
+ * Take zone->lock for a bulk operation on a pcp list, accounting the
+ * time spent waiting for it. Returns true if the lock was contended and
+ * stores the time it was acquired in @locked.
+ */
+static inline bool pcp_lock_zone(struct zone *zone, struct per_cpu_pages *pcp,
+				 u64 *locked)
+{
+	bool contended = false;
+
+	if (!spin_trylock(&zone->lock)) {
+		u64 start = local_clock();
+
+		spin_lock(&zone->lock);
+		*locked = local_clock();
+		pcp->lock_wait_ns += *locked - start;
+		pcp->lock_contended++;
+		contended = true;
+	} else
+		*locked = local_clock();
+	pcp->lock_acquired++;
+	return contended;
+}
+
+static inline void pcp_unlock_zone(struct zone *zone,
+				   struct per_cpu_pages *pcp, u64 locked)
+{
+	pcp->lock_hold_ns += local_clock() - locked;
+	spin_unlock(&zone->lock);
+}
+
+/*
+ * Adapt the batch of a pcp list after a bulk operation. Contention on
+ * zone->lock means several cpus are refilling or draining at the same
+ * time, so do that less often with more pages each time. When free
+ * memory is low, pages parked on pcp lists are better off in the buddy
+ * lists, so shrink the batch and with it the high watermark.
+ */
+static void pcp_adapt_batch(struct zone *zone, struct per_cpu_pages *pcp,
+			    bool contended)
+{
+	int base = pcp->base_batch;
+	int batch = pcp->batch;
+
+	if (!base)
+		return;
+
+	if (zone_page_state(zone, NR_FREE_PAGES) <= low_wmark_pages(zone))
+		batch = max(batch / 2, max(base / PCP_BATCH_SCALE, 1));
+	else if (contended)
+		batch = min(batch * 2, base * PCP_BATCH_SCALE);
+	else if (batch != base && ++pcp->batch_stable >= PCP_BATCH_DECAY)
+		batch = batch > base ? max(batch / 2, base) :
+				       min(batch * 2, base);
+
+	if (batch != pcp->batch || contended) {
+		pcp->batch = batch;
+		pcp->high = 6 * batch;
+		pcp->batch_stable = 0;
+	}
+}
+
 /*
  * Frees a number of pages from the PCP lists
  * Assumes all pages on list are in same zone, and of same order.
@@ -596,8 +669,10 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	int migratetype = 0;
 	int batch_free = 0;
 	int to_free = count;
+	bool contended;
+	u64 locked;
 
-	spin_lock(&zone->lock);
+	contended = pcp_lock_zone(zone, pcp, &locked);
 	zone->all_unreclaimable = 0;
 	zone->pages_scanned = 0;
 
@@ -633,7 +708,8 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 		} while (--to_free && --batch_free && !list_empty(list));
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, count);
-	spin_unlock(&zone->lock);
+	pcp_unlock_zone(zone, pcp, locked);
+	pcp_adapt_batch(zone, pcp, contended);
 }
 
 static void free_one_page(struct zone *zone, struct page *page, int order,
@@ -702,13 +778,14 @@ void __meminit __free_pages_bootmem(struct page *page, unsigned int order)
 		set_page_refcounted(page);
 		__free_page(page);
 	} else {
-		int loop;
+		unsigned int nr_pages = 1 << order;
+		unsigned int loop;
 
 		prefetchw(page);
-		for (loop = 0; loop < BITS_PER_LONG; loop++) {
+		for (loop = 0; loop < nr_pages; loop++) {
 			struct page *p = &page[loop];
 
-			if (loop + 1 < BITS_PER_LONG)
+			if (loop + 1 < nr_pages)
 				prefetchw(p + 1);
 			__ClearPageReserved(p);
 			set_page_count(p, 0);
@@ -827,11 +904,17 @@ struct page *__rmqueue_smallest(struct zone *zone, unsigned int order,
  * This array describes the order lists are fallen back to when
  * the free lists for the desirable migrate type are depleted
  */
-static int fallbacks[MIGRATE_TYPES][MIGRATE_TYPES-1] = {
-	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,   MIGRATE_RESERVE },
-	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
-	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE,     MIGRATE_RESERVE,   MIGRATE_RESERVE }, /* Never used */
+static int fallbacks[MIGRATE_TYPES][4] = {
+	[MIGRATE_UNMOVABLE]   = { MIGRATE_RECLAIMABLE, MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+	[MIGRATE_RECLAIMABLE] = { MIGRATE_UNMOVABLE,   MIGRATE_MOVABLE,     MIGRATE_RESERVE },
+#ifdef CONFIG_CMA
+	[MIGRATE_MOVABLE]     = { MIGRATE_CMA,         MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE, MIGRATE_RESERVE },
+	[MIGRATE_CMA]         = { MIGRATE_RESERVE }, /* Never used */
+#else
+	[MIGRATE_MOVABLE]     = { MIGRATE_RECLAIMABLE, MIGRATE_UNMOVABLE,   MIGRATE_RESERVE },
+#endif
+	[MIGRATE_RESERVE]     = { MIGRATE_RESERVE }, /* Never used */
+	[MIGRATE_ISOLATE]     = { MIGRATE_RESERVE }, /* Never used */
 };
 
 /*
@@ -926,12 +1009,12 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 	/* Find the largest possible block of pages in the other list */
 	for (current_order = MAX_ORDER-1; current_order >= order;
 						--current_order) {
-		for (i = 0; i < MIGRATE_TYPES - 1; i++) {
+		for (i = 0;; i++) {
 			migratetype = fallbacks[start_migratetype][i];
 
 			/* MIGRATE_RESERVE handled later if necessary */
 			if (migratetype == MIGRATE_RESERVE)
-				continue;
+				break;
 
 			area = &(zone->free_area[current_order]);
 			if (list_empty(&area->free_list[migratetype]))
@@ -946,10 +1029,16 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			 * pages to the preferred allocation list. If falling
 			 * back for a reclaimable kernel allocation, be more
 			 * aggressive about taking ownership of free pages
+			 *
+			 * On the other hand, never change the migration type
+			 * of MIGRATE_CMA pageblocks nor move CMA pages to
+			 * other free lists: unmovable pages must not end up
+			 * in a contiguous memory area.
 			 */
-			if (unlikely(current_order >= (pageblock_order >> 1)) ||
-					start_migratetype == MIGRATE_RECLAIMABLE ||
-					page_group_by_mobility_disabled) {
+			if (!is_migrate_cma(migratetype) &&
+			    (unlikely(current_order >= (pageblock_order >> 1)) ||
+			     start_migratetype == MIGRATE_RECLAIMABLE ||
+			     page_group_by_mobility_disabled)) {
 				unsigned long pages;
 				pages = move_freepages_block(zone, page,
 								start_migratetype);
@@ -968,11 +1057,14 @@ __rmqueue_fallback(struct zone *zone, int order, int start_migratetype)
 			rmv_page_order(page);
 
 			/* Take ownership for orders >= pageblock_order */
-			if (current_order >= pageblock_order)
+			if (current_order >= pageblock_order &&
+			    !is_migrate_cma(migratetype))
 				change_pageblock_range(page, current_order,
 							start_migratetype);
 
-			expand(zone, page, order, current_order, area, migratetype);
+			expand(zone, page, order, current_order, area,
+			       is_migrate_cma(migratetype)
+			     ? migratetype : start_migratetype);
 
 			trace_mm_page_alloc_extfrag(page, order, current_order,
 				start_migratetype, migratetype);
@@ -1021,11 +1113,13 @@ retry_reserve:
  */
 static int rmqueue_bulk(struct zone *zone, unsigned int order, 
 			unsigned long count, struct list_head *list,
-			int migratetype, int cold)
+			int migratetype, int cold, struct per_cpu_pages *pcp)
 {
-	int i;
+	int i, mt;
+	bool contended;
+	u64 locked;
 	
-	spin_lock(&zone->lock);
+	contended = pcp_lock_zone(zone, pcp, &locked);
 	for (i = 0; i < count; ++i) {
 		struct page *page = __rmqueue(zone, order, migratetype);
 		if (unlikely(page == NULL))
@@ -1044,11 +1138,16 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 			list_add(&page->lru, list);
 		else
 			list_add_tail(&page->lru, list);
-		set_page_private(page, migratetype);
+		/* CMA pages must go back to their own free list */
+		mt = get_pageblock_migratetype(page);
+		if (!is_migrate_cma(mt))
+			mt = migratetype;
+		set_page_private(page, mt);
 		list = &page->lru;
 	}
 	__mod_zone_page_state(zone, NR_FREE_PAGES, -(i << order));
-	spin_unlock(&zone->lock);
+	pcp_unlock_zone(zone, pcp, locked);
+	pcp_adapt_batch(zone, pcp, contended);
 	return i;
 }
 
@@ -1201,8 +1300,11 @@ void free_hot_cold_page(struct page *page, int cold)
 		list_add(&page->lru, &pcp->lists[migratetype]);
 	pcp->count++;
 	if (pcp->count >= pcp->high) {
-		free_pcppages_bulk(zone, pcp->batch, pcp);
-		pcp->count -= pcp->batch;
+		int batch = pcp->batch;
+
+		/* free_pcppages_bulk() may adapt pcp->batch */
+		free_pcppages_bulk(zone, batch, pcp);
+		pcp->count -= batch;
 	}
 
 out:
@@ -1252,15 +1354,22 @@ int split_free_page(struct page *page)
 	unsigned int order;
 	unsigned long watermark;
 	struct zone *zone;
+	int mt;
 
 	BUG_ON(!PageBuddy(page));
 
 	zone = page_zone(page);
 	order = page_order(page);
+	mt = get_pageblock_migratetype(page);
 
-	/* Obey watermarks as if the page was being allocated */
+	/*
+	 * Obey watermarks as if the page was being allocated.  Isolated
+	 * pages cannot be allocated anyway, alloc_contig_range() takes
+	 * them regardless.
+	 */
 	watermark = low_wmark_pages(zone) + (1 << order);
-	if (!zone_watermark_ok(zone, 0, watermark, 0, 0))
+	if (mt != MIGRATE_ISOLATE &&
+	    !zone_watermark_ok(zone, 0, watermark, 0, 0))
 		return 0;
 
 	/* Remove page from free list */
@@ -1273,7 +1382,8 @@ int split_free_page(struct page *page)
 	set_page_refcounted(page);
 	split_page(page, order);
 
-	if (order >= pageblock_order - 1) {
+	if (order >= pageblock_order - 1 &&
+	    mt != MIGRATE_ISOLATE && !is_migrate_cma(mt)) {
 		struct page *endpage = page + (1 << order) - 1;
 		for (; page < endpage; page += pageblock_nr_pages)
 			set_pageblock_migratetype(page, MIGRATE_MOVABLE);
@@ -1307,7 +1417,7 @@ again:
 		if (list_empty(list)) {
 			pcp->count += rmqueue_bulk(zone, 0,
 					pcp->batch, list,
-					migratetype, cold);
+					migratetype, cold, pcp);
 			if (unlikely(list_empty(list)))
 				goto failed;
 		}
@@ -3496,6 +3606,102 @@ static void setup_zone_migrate_reserve(struct zone *zone)
 	}
 }
 
+/*
+ * Initialise the struct page of @pfn, leaving the pageblock flags alone.
+ */
+void __meminit __init_single_page(unsigned long pfn, unsigned long zone,
+				  int nid)
+{
+	struct page *page = pfn_to_page(pfn);
+
+	set_page_links(page, zone, nid, pfn);
+	mminit_verify_page_links(page, zone, nid, pfn);
+	init_page_count(page);
+	reset_page_mapcount(page);
+	SetPageReserved(page);
+	INIT_LIST_HEAD(&page->lru);
+#ifdef WANT_PAGE_VIRTUAL
+	/* The shift won't overflow because ZONE_NORMAL is below 4G. */
+	if (!is_highmem_idx(zone))
+		set_page_address(page, __va(pfn << PAGE_SHIFT));
+#endif
+}
+
+void __meminit __init_single_pfn(unsigned long pfn, unsigned long zone,
+				 int nid)
+{
+	struct page *page = pfn_to_page(pfn);
+	struct zone *z = &NODE_DATA(nid)->node_zones[zone];
+
+	__init_single_page(pfn, zone, nid);
+	/*
+	 * Mark the block movable so that blocks are reserved for
+	 * movable at startup. This will force kernel allocations
+	 * to reserve their blocks rather than leaking throughout
+	 * the address space during boot when many long-lived
+	 * kernel allocations are made. Later some blocks near
+	 * the start are marked MIGRATE_RESERVE by
+	 * setup_zone_migrate_reserve()
+	 *
+	 * bitmap is created for zone's valid pfn range. but memmap
+	 * can be created for invalid pages (for alignment)
+	 * check here not to call set_pageblock_migratetype() against
+	 * pfn out of zone.
+	 */
+	if ((z->zone_start_pfn <= pfn)
+	    && (pfn < z->zone_start_pfn + z->spanned_pages)
+	    && !(pfn & (pageblock_nr_pages - 1)))
+		set_pageblock_migratetype(page, MIGRATE_MOVABLE);
+}
+
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+/*
+ * Struct pages of the first DEFERRED_INIT_PAGES of a node's highest zone
+ * are initialised at boot, enough to get the secondary CPUs up.  The rest
+ * is left to page_alloc_init_late(), except for reserved pages, which
+ * free_all_bootmem() initialises.  This relies on the memmap coming
+ * zeroed from bootmem, so that nothing mistakes a deferred page for an
+ * allocated one in the meantime.
+ */
+#define DEFERRED_INIT_PAGES	(256UL << (20 - PAGE_SHIFT))
+
+static inline void reset_deferred_meminit(pg_data_t *pgdat)
+{
+	pgdat->first_deferred_pfn = ULONG_MAX;
+}
+
+/* Returns true if the struct page for @pfn is to be initialised now */
+static inline bool update_defer_init(pg_data_t *pgdat, unsigned long zone,
+				     unsigned long pfn, unsigned long start_pfn)
+{
+	struct zone *z = &pgdat->node_zones[zone];
+
+	/* Lower zones and highmem, which bootmem does not free, are not */
+	if (is_highmem_idx(zone) ||
+	    z->zone_start_pfn + z->spanned_pages <
+			pgdat->node_start_pfn + pgdat->node_spanned_pages ||
+	    z->zone_start_pfn + z->spanned_pages > pgdat->bdata->node_low_pfn)
+		return true;
+
+	if (pfn - start_pfn < DEFERRED_INIT_PAGES ||
+	    (pfn & (MAX_ORDER_NR_PAGES - 1)))
+		return true;
+
+	pgdat->first_deferred_pfn = pfn;
+	return false;
+}
+#else
+static inline void reset_deferred_meminit(pg_data_t *pgdat)
+{
+}
+
+static inline bool update_defer_init(pg_data_t *pgdat, unsigned long zone,
+				     unsigned long pfn, unsigned long start_pfn)
+{
+	return true;
+}
+#endif /* CONFIG_DEFERRED_STRUCT_PAGE_INIT */
+
 /*
  * Initially all pages are reserved - free ones are freed
  * up by free_all_bootmem() once the early boot process is
@@ -3504,15 +3710,13 @@ static void setup_zone_migrate_reserve(struct zone *zone)
 void __meminit memmap_init_zone(unsigned long size, int nid, unsigned long zone,
 		unsigned long start_pfn, enum memmap_context context)
 {
-	struct page *page;
+	pg_data_t *pgdat = NODE_DATA(nid);
 	unsigned long end_pfn = start_pfn + size;
 	unsigned long pfn;
-	struct zone *z;
 
 	if (highest_memmap_pfn < end_pfn - 1)
 		highest_memmap_pfn = end_pfn - 1;
 
-	z = &NODE_DATA(nid)->node_zones[zone];
 	for (pfn = start_pfn; pfn < end_pfn; pfn++) {
 		/*
 		 * There can be holes in boot-time mem_map[]s
@@ -3524,38 +3728,10 @@ void __meminit memmap_init_zone(unsigned long size, int nid, unsigned long zone,
 				continue;
 			if (!early_pfn_in_nid(pfn, nid))
 				continue;
+			if (!update_defer_init(pgdat, zone, pfn, start_pfn))
+				break;
 		}
-		page = pfn_to_page(pfn);
-		set_page_links(page, zone, nid, pfn);
-		mminit_verify_page_links(page, zone, nid, pfn);
-		init_page_count(page);
-		reset_page_mapcount(page);
-		SetPageReserved(page);
-		/*
-		 * Mark the block movable so that blocks are reserved for
-		 * movable at startup. This will force kernel allocations
-		 * to reserve their blocks rather than leaking throughout
-		 * the address space during boot when many long-lived
-		 * kernel allocations are made. Later some blocks near
-		 * the start are marked MIGRATE_RESERVE by
-		 * setup_zone_migrate_reserve()
-		 *
-		 * bitmap is created for zone's valid pfn range. but memmap
-		 * can be created for invalid pages (for alignment)
-		 * check here not to call set_pageblock_migratetype() against
-		 * pfn out of zone.
-		 */
-		if ((z->zone_start_pfn <= pfn)
-		    && (pfn < z->zone_start_pfn + z->spanned_pages)
-		    && !(pfn & (pageblock_nr_pages - 1)))
-			set_pageblock_migratetype(page, MIGRATE_MOVABLE);
-
-		INIT_LIST_HEAD(&page->lru);
-#ifdef WANT_PAGE_VIRTUAL
-		/* The shift won't overflow because ZONE_NORMAL is below 4G. */
-		if (!is_highmem_idx(zone))
-			set_page_address(page, __va(pfn << PAGE_SHIFT));
-#endif
+		__init_single_pfn(pfn, zone, nid);
 	}
 }
 
@@ -3634,6 +3810,7 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->count = 0;
 	pcp->high = 6 * batch;
 	pcp->batch = max(1UL, 1 * batch);
+	pcp->base_batch = batch;
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
 }
@@ -3653,6 +3830,8 @@ static void setup_pagelist_highmark(struct per_cpu_pageset *p,
 	pcp->batch = max(1UL, high/4);
 	if ((high/4) > (PAGE_SHIFT * 8))
 		pcp->batch = PAGE_SHIFT * 8;
+	/* an explicitly set high mark disables the adaptive batch */
+	pcp->base_batch = 0;
 }
 
 static void setup_zone_pageset(struct zone *zone)
@@ -4475,6 +4654,7 @@ void __paginginit free_area_init_node(int nid, unsigned long *zones_size,
 
 	pgdat->node_id = nid;
 	pgdat->node_start_pfn = node_start_pfn;
+	reset_deferred_meminit(pgdat);
 	calculate_node_totalpages(pgdat, zones_size, zholes_size);
 
 	alloc_node_mem_map(pgdat);
@@ -5061,6 +5241,154 @@ void __init page_alloc_init(void)
 	hotcpu_notifier(page_alloc_cpu_notify, 0);
 }
 
+#ifdef CONFIG_DEFERRED_STRUCT_PAGE_INIT
+static void __set_pfnblock_flags_group(struct zone *zone, unsigned long pfn,
+				       unsigned long flags,
+				       int start_bitidx, int end_bitidx);
+
+struct deferred_init_work {
+	int nid;
+	unsigned long start_pfn;
+	unsigned long end_pfn;
+	unsigned long nr_pages;
+};
+
+static atomic_t deferred_init_pending __initdata;
+static __initdata DECLARE_COMPLETION(deferred_init_done);
+
+static int __init deferred_init_memmap(void *data)
+{
+	struct deferred_init_work *work = data;
+
+	work->nr_pages = deferred_free_bootmem_range(work->nid,
+					work->start_pfn, work->end_pfn);
+	if (atomic_dec_and_test(&deferred_init_pending))
+		complete(&deferred_init_done);
+	return 0;
+}
+
+static void __init deferred_init_start(struct deferred_init_work *work,
+				       int cpu)
+{
+	struct task_struct *p;
+
+	atomic_inc(&deferred_init_pending);
+	p = kthread_create_on_node(deferred_init_memmap, work, work->nid,
+				   "pgdatinit%d", work->nid);
+	if (IS_ERR(p)) {
+		deferred_init_memmap(work);
+		return;
+	}
+	if (cpu < nr_cpu_ids)
+		kthread_bind(p, cpu);
+	wake_up_process(p);
+}
+
+/*
+ * Mark the deferred pageblocks of @pgdat movable, as __init_single_pfn()
+ * would have.  The flags of several pageblocks share a word of the
+ * bitmap, so this is not left to the pgdatinit threads: neighbouring
+ * chunks would race, and so would the allocator, already running on
+ * the blocks below first_deferred_pfn, whose updates are serialised
+ * by zone->lock.
+ */
+static void __init deferred_init_pageblocks(pg_data_t *pgdat)
+{
+	struct zone *zone = &pgdat->node_zones[pgdat->nr_zones - 1];
+	unsigned long end_pfn = zone->zone_start_pfn + zone->spanned_pages;
+	unsigned long pfn, flags;
+
+	for (pfn = ALIGN(pgdat->first_deferred_pfn, pageblock_nr_pages);
+	     pfn < end_pfn; pfn += pageblock_nr_pages) {
+		if (!pfn_valid(pfn))
+			continue;
+		spin_lock_irqsave(&zone->lock, flags);
+		__set_pfnblock_flags_group(zone, pfn, MIGRATE_MOVABLE,
+					   PB_migrate, PB_migrate_end);
+		spin_unlock_irqrestore(&zone->lock, flags);
+	}
+}
+
+/*
+ * Initialise and free the struct pages that memmap_init_zone() left
+ * alone, with one kthread per online CPU of each node, each taking a
+ * slice of the node.  Called once the secondary CPUs are up; waits for
+ * the threads, so nothing past it sees a deferred page.
+ */
+void __init page_alloc_init_late(void)
+{
+	struct deferred_init_work *works, onstack;
+	unsigned long start = jiffies, nr_pages = 0;
+	int nr_works = 0, max_works;
+	int nid, cpu, i;
+
+	max_works = num_online_cpus() + num_node_state(N_HIGH_MEMORY);
+	works = kcalloc(max_works, sizeof(*works), GFP_KERNEL);
+	if (!works)
+		max_works = 0;
+
+	atomic_set(&deferred_init_pending, 1);
+	for_each_node_state(nid, N_HIGH_MEMORY) {
+		pg_data_t *pgdat = NODE_DATA(nid);
+		unsigned long start_pfn = pgdat->first_deferred_pfn;
+		unsigned long end_pfn = pgdat->node_start_pfn +
+					pgdat->node_spanned_pages;
+		unsigned long chunk;
+		int nr_cpus = 0;
+
+		if (start_pfn >= end_pfn)
+			continue;
+		deferred_init_pageblocks(pgdat);
+
+		for_each_cpu_and(cpu, cpumask_of_node(nid), cpu_online_mask)
+			nr_cpus++;
+		if (nr_works + max(nr_cpus, 1) > max_works) {
+			/* Out of memory for the bookkeeping, do it here */
+			onstack.nid = nid;
+			onstack.start_pfn = start_pfn;
+			onstack.end_pfn = end_pfn;
+			atomic_inc(&deferred_init_pending);
+			deferred_init_memmap(&onstack);
+			nr_pages += onstack.nr_pages;
+			continue;
+		}
+
+		chunk = DIV_ROUND_UP(end_pfn - start_pfn, max(nr_cpus, 1));
+		chunk = ALIGN(chunk, MAX_ORDER_NR_PAGES);
+		cpu = nr_cpu_ids;
+		if (nr_cpus)
+			cpu = cpumask_first_and(cpumask_of_node(nid),
+						cpu_online_mask);
+		while (start_pfn < end_pfn) {
+			struct deferred_init_work *work = &works[nr_works++];
+
+			work->nid = nid;
+			work->start_pfn = start_pfn;
+			work->end_pfn = min(start_pfn + chunk, end_pfn);
+			deferred_init_start(work, cpu);
+			start_pfn = work->end_pfn;
+			if (cpu < nr_cpu_ids)
+				cpu = cpumask_next_and(cpu,
+					cpumask_of_node(nid), cpu_online_mask);
+		}
+	}
+	if (!atomic_dec_and_test(&deferred_init_pending))
+		wait_for_completion(&deferred_init_done);
+
+	for (i = 0; i < nr_works; i++)
+		nr_pages += works[i].nr_pages;
+	kfree(works);
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		deferred_free_bootmem_map(nid);
+
+	if (nr_pages)
+		printk(KERN_INFO "page_alloc: initialised %lu deferred pages "
+		       "in %ums\n", nr_pages,
+		       jiffies_to_msecs(jiffies - start));
+}
+#endif /* CONFIG_DEFERRED_STRUCT_PAGE_INIT */
+
 /*
  * calculate_totalreserve_pages - called when sysctl_lower_zone_reserve_ratio
  *	or min_free_kbytes changes.
@@ -5528,23 +5856,15 @@ unsigned long get_pageblock_flags_group(struct page *page,
 	return flags;
 }
 
-/**
- * set_pageblock_flags_group - Set the requested group of flags for a pageblock_nr_pages block of pages
- * @page: The page within the block of interest
- * @start_bitidx: The first bit of interest
- * @end_bitidx: The last bit of interest
- * @flags: The flags to set
- */
-void set_pageblock_flags_group(struct page *page, unsigned long flags,
-					int start_bitidx, int end_bitidx)
+/* Set pageblock flags by pfn, for blocks whose struct pages are not set up */
+static void __set_pfnblock_flags_group(struct zone *zone, unsigned long pfn,
+				       unsigned long flags,
+				       int start_bitidx, int end_bitidx)
 {
-	struct zone *zone;
 	unsigned long *bitmap;
-	unsigned long pfn, bitidx;
+	unsigned long bitidx;
 	unsigned long value = 1;
 
-	zone = page_zone(page);
-	pfn = page_to_pfn(page);
 	bitmap = get_pageblock_bitmap(zone, pfn);
 	bitidx = pfn_to_bitidx(zone, pfn);
 	VM_BUG_ON(pfn < zone->zone_start_pfn);
@@ -5557,6 +5877,20 @@ void set_pageblock_flags_group(struct page *page, unsigned long flags,
 			__clear_bit(bitidx + start_bitidx, bitmap);
 }
 
+/**
+ * set_pageblock_flags_group - Set the requested group of flags for a pageblock_nr_pages block of pages
+ * @page: The page within the block of interest
+ * @start_bitidx: The first bit of interest
+ * @end_bitidx: The last bit of interest
+ * @flags: The flags to set
+ */
+void set_pageblock_flags_group(struct page *page, unsigned long flags,
+					int start_bitidx, int end_bitidx)
+{
+	__set_pfnblock_flags_group(page_zone(page), page_to_pfn(page), flags,
+				   start_bitidx, end_bitidx);
+}
+
 /*
  * This is designed as sub function...plz see page_isolation.c also.
  * set/clear page block's type to be ISOLATE.
@@ -5567,6 +5901,8 @@ static int
 __count_immobile_pages(struct zone *zone, struct page *page, int count)
 {
 	unsigned long pfn, iter, found;
+	int mt;
+
 	/*
 	 * For avoiding noise data, lru_add_drain_all() should be called
 	 * If ZONE_MOVABLE, the zone never contains immobile pages
@@ -5574,7 +5910,8 @@ __count_immobile_pages(struct zone *zone, struct page *page, int count)
 	if (zone_idx(zone) == ZONE_MOVABLE)
 		return true;
 
-	if (get_pageblock_migratetype(page) == MIGRATE_MOVABLE)
+	mt = get_pageblock_migratetype(page);
+	if (mt == MIGRATE_MOVABLE || is_migrate_cma(mt))
 		return true;
 
 	pfn = page_to_pfn(page);
@@ -5684,7 +6021,7 @@ out:
 	return ret;
 }
 
-void unset_migratetype_isolate(struct page *page)
+void unset_migratetype_isolate(struct page *page, unsigned migratetype)
 {
 	struct zone *zone;
 	unsigned long flags;
@@ -5692,12 +6029,218 @@ void unset_migratetype_isolate(struct page *page)
 	spin_lock_irqsave(&zone->lock, flags);
 	if (get_pageblock_migratetype(page) != MIGRATE_ISOLATE)
 		goto out;
-	set_pageblock_migratetype(page, MIGRATE_MOVABLE);
-	move_freepages_block(zone, page, MIGRATE_MOVABLE);
+	set_pageblock_migratetype(page, migratetype);
+	move_freepages_block(zone, page, migratetype);
 out:
 	spin_unlock_irqrestore(&zone->lock, flags);
 }
 
+#ifdef CONFIG_CMA
+
+static unsigned long pfn_max_align_down(unsigned long pfn)
+{
+	return pfn & ~(max_t(unsigned long, MAX_ORDER_NR_PAGES,
+			     pageblock_nr_pages) - 1);
+}
+
+static unsigned long pfn_max_align_up(unsigned long pfn)
+{
+	return ALIGN(pfn, max_t(unsigned long, MAX_ORDER_NR_PAGES,
+				pageblock_nr_pages));
+}
+
+static struct page *
+__alloc_contig_migrate_alloc(struct page *page, unsigned long private,
+			     int **resultp)
+{
+	return alloc_page(GFP_HIGHUSER_MOVABLE);
+}
+
+/* [start, end) must belong to a single zone. */
+static int __alloc_contig_migrate_range(unsigned long start, unsigned long end)
+{
+	/* This function is based on compact_zone() from compaction.c. */
+
+	unsigned long pfn = start;
+	unsigned int tries = 0;
+	int ret = 0;
+
+	struct compact_control cc = {
+		.nr_migratepages = 0,
+		.order = -1,
+		.zone = page_zone(pfn_to_page(start)),
+		.sync = true,
+	};
+	INIT_LIST_HEAD(&cc.migratepages);
+
+	migrate_prep_local();
+
+	while (pfn < end || !list_empty(&cc.migratepages)) {
+		if (fatal_signal_pending(current)) {
+			ret = -EINTR;
+			break;
+		}
+
+		if (list_empty(&cc.migratepages)) {
+			cc.nr_migratepages = 0;
+			pfn = isolate_migratepages_range(cc.zone, &cc,
+							 pfn, end);
+			if (!pfn) {
+				ret = -EINTR;
+				break;
+			}
+			tries = 0;
+		} else if (++tries == 5) {
+			ret = ret < 0 ? ret : -EBUSY;
+			break;
+		}
+
+		ret = migrate_pages(&cc.migratepages,
+				    __alloc_contig_migrate_alloc,
+				    0, false, true);
+	}
+
+	putback_lru_pages(&cc.migratepages);
+	return ret > 0 ? 0 : ret;
+}
+
+/**
+ * alloc_contig_range() -- tries to allocate given range of pages
+ * @start:	start PFN to allocate
+ * @end:	one-past-the-last PFN to allocate
+ * @migratetype:	migratetype of the underlaying pageblocks (either
+ *			#MIGRATE_MOVABLE or #MIGRATE_CMA).  All pageblocks
+ *			in range must have the same migratetype and it must
+ *			be either of the two.
+ *
+ * The PFN range does not have to be pageblock or MAX_ORDER_NR_PAGES
+ * aligned, however it's the caller's responsibility to guarantee that
+ * we are the only thread that changes migrate type of pageblocks the
+ * pages fall in.
+ *
+ * The PFN range must belong to a single zone.
+ *
+ * Returns zero on success or negative error code.  On success all
+ * pages which PFN is in [start, end) are allocated for the caller and
+ * need to be freed with free_contig_range().
+ */
+int alloc_contig_range(unsigned long start, unsigned long end,
+		       unsigned migratetype)
+{
+	unsigned long outer_start, outer_end;
+	int ret = 0, order;
+
+	/*
+	 * What we do here is we mark all pageblocks in range as
+	 * MIGRATE_ISOLATE.  Because pageblock and max order pages may
+	 * have different sizes, and due to the way page allocator
+	 * work, we align the range to biggest of the two pages so
+	 * that page allocator won't try to merge buddies from
+	 * different pageblocks and change MIGRATE_ISOLATE to some
+	 * other migration type.
+	 *
+	 * Once the pageblocks are marked as MIGRATE_ISOLATE, we
+	 * migrate the pages from an unaligned range (ie. pages that
+	 * we are interested in).  This will put all the pages in
+	 * range back to page allocator as MIGRATE_ISOLATE.
+	 *
+	 * When this is done, we take the pages in range from page
+	 * allocator removing them from the buddy system.  This way
+	 * page allocator will never consider using them.
+	 *
+	 * This lets us mark the pageblocks back as
+	 * MIGRATE_CMA/MIGRATE_MOVABLE so that free pages in the
+	 * aligned range but not in the unaligned, original range are
+	 * put back to page allocator so that buddy can use them.
+	 */
+
+	ret = start_isolate_page_range(pfn_max_align_down(start),
+				       pfn_max_align_up(end), migratetype);
+	if (ret)
+		goto done;
+
+	ret = __alloc_contig_migrate_range(start, end);
+	if (ret)
+		goto done;
+
+	/*
+	 * Pages from [start, end) are within a MAX_ORDER_NR_PAGES
+	 * aligned blocks that are marked as MIGRATE_ISOLATE.  What's
+	 * more, all pages in [start, end) are free in page allocator.
+	 * What we are going to do is to allocate all pages from
+	 * [start, end) (that is remove them from page allocator).
+	 *
+	 * The only problem is that pages at the beginning and at the
+	 * end of interesting range may be not aligned with pages that
+	 * page allocator holds, ie. they can be part of higher order
+	 * pages.  Because of this, we reserve the bigger range and
+	 * once this is done free the pages we are not interested in.
+	 */
+
+	lru_add_drain_all();
+	drain_all_pages();
+
+	order = 0;
+	outer_start = start;
+	while (!PageBuddy(pfn_to_page(outer_start))) {
+		if (++order >= MAX_ORDER) {
+			ret = -EBUSY;
+			goto done;
+		}
+		outer_start &= ~0UL << order;
+	}
+
+	/* Make sure the range is really isolated. */
+	if (test_pages_isolated(outer_start, end)) {
+		pr_warn("alloc_contig_range test_pages_isolated(%lx, %lx) failed\n",
+		       outer_start, end);
+		ret = -EBUSY;
+		goto done;
+	}
+
+	outer_end = isolate_freepages_range(outer_start, end);
+	if (!outer_end) {
+		ret = -EBUSY;
+		goto done;
+	}
+
+	/* Free head and tail (if any) */
+	if (start != outer_start)
+		free_contig_range(outer_start, start - outer_start);
+	if (end != outer_end)
+		free_contig_range(end, outer_end - end);
+
+done:
+	undo_isolate_page_range(pfn_max_align_down(start),
+				pfn_max_align_up(end), migratetype);
+	return ret;
+}
+
+void free_contig_range(unsigned long pfn, unsigned nr_pages)
+{
+	for (; nr_pages--; ++pfn)
+		__free_page(pfn_to_page(pfn));
+}
+
+/* Free whole pageblock and set it's migration type to MIGRATE_CMA. */
+void __init init_cma_reserved_pageblock(struct page *page)
+{
+	unsigned i = pageblock_nr_pages;
+	struct page *p = page;
+
+	do {
+		__ClearPageReserved(p);
+		set_page_count(p, 0);
+	} while (++p, --i);
+
+	set_page_refcounted(page);
+	set_pageblock_migratetype(page, MIGRATE_CMA);
+	__free_pages(page, pageblock_order);
+	totalram_pages += pageblock_nr_pages;
+}
+
+#endif /* CONFIG_CMA */
+
 #ifdef CONFIG_MEMORY_HOTREMOVE
 /*
  * All pages in the range must be isolated before calling this.
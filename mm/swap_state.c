@@ -19,6 +19,9 @@
 #include <linux/pagevec.h>
 #include <linux/migrate.h>
 #include <linux/page_cgroup.h>
+#include <linux/log2.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
 
 #include <asm/pgtable.h>
 
@@ -254,6 +257,12 @@ void free_pages_and_swap_cache(struct page **pages, int nr)
 	}
 }
 
+/*
+ * Readahead hits since the last swap_vma_readahead(), which sizes its
+ * window by them.
+ */
+static atomic_t swap_vma_ra_hits = ATOMIC_INIT(0);
+
 /*
  * Lookup a swap entry in the swap cache. A found page will be returned
  * unlocked and with its refcount incremented - we rely on the kernel
@@ -266,8 +275,14 @@ struct page * lookup_swap_cache(swp_entry_t entry)
 
 	page = find_get_page(&swapper_space, entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		/* PG_readahead is PG_reclaim while under writeback */
+		if (!PageWriteback(page) && TestClearPageReadahead(page)) {
+			atomic_inc(&swap_vma_ra_hits);
+			count_vm_event(SWAP_RA_HIT);
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
@@ -278,9 +293,13 @@ struct page * lookup_swap_cache(swp_entry_t entry)
  * and reading the disk if it is not already cached.
  * A failure return means that either the page allocation failed or that
  * the swap entry is no longer in use.
+ *
+ * A page that has to be read in for @readahead is marked PG_readahead,
+ * so that lookup_swap_cache() can tell when it turns out to be used.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			int readahead)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
@@ -349,6 +368,10 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 			/*
 			 * Initiate read into locked page and return.
 			 */
+			if (readahead) {
+				SetPageReadahead(new_page);
+				count_vm_event(SWAP_RA);
+			}
 			lru_cache_add_anon(new_page);
 			swap_readpage(new_page);
 			return new_page;
@@ -368,6 +391,12 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	return __read_swap_cache_async(entry, gfp_mask, vma, addr, 0);
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -414,3 +443,214 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	lru_add_drain();	/* Push any new pages onto the LRU now */
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
+
+/*
+ * VMA based swap readahead.
+ *
+ * Neighbouring swap slots need not hold neighbouring pages: on zram, or
+ * once the swap area is fragmented, reading around the slot mostly brings
+ * in pages nobody is about to touch.  When enabled, anonymous faults read
+ * the swap entries of the ptes around the faulting address instead.  The
+ * window grows with the readahead pages used since the last fault, and
+ * follows the direction of sequential faults.
+ */
+static int swap_vma_ra_enabled __read_mostly;
+static unsigned int swap_vma_ra_max_order __read_mostly = 3;
+
+static unsigned int swap_vma_ra_win = 1;	/* pages, last window */
+static unsigned long swap_vma_ra_prev;		/* last faulting address */
+
+#define SWAP_VMA_RA_ORDER_MAX	ilog2(PTRS_PER_PTE)
+
+static unsigned int swap_vma_ra_window(unsigned long addr, int *dir)
+{
+	unsigned long prev = ACCESS_ONCE(swap_vma_ra_prev);
+	unsigned int hits, pages, max_pages;
+
+	hits = atomic_xchg(&swap_vma_ra_hits, 0);
+	max_pages = 1 << ACCESS_ONCE(swap_vma_ra_max_order);
+
+	*dir = 0;
+	if (addr == prev + PAGE_SIZE)
+		*dir = 1;
+	else if (addr == prev - PAGE_SIZE)
+		*dir = -1;
+	swap_vma_ra_prev = addr;
+
+	pages = hits + 2;
+	if (pages == 2) {
+		/* Nothing used lately: only read ahead of sequential faults */
+		if (!*dir)
+			pages = 1;
+	} else
+		pages = roundup_pow_of_two(pages);
+
+	/* Don't shrink the window too fast */
+	pages = max(pages, ACCESS_ONCE(swap_vma_ra_win) / 2);
+	pages = min(pages, max_pages);
+	swap_vma_ra_win = pages;
+
+	return pages;
+}
+
+/**
+ * swap_vma_readahead - swap in pages around a faulting address
+ * @fentry: swap entry of the faulting pte
+ * @gfp_mask: memory allocation flags
+ * @vma: user vma the address belongs to
+ * @addr: the faulting address
+ * @pmd: pmd of the faulting pte
+ *
+ * Returns the struct page for @fentry, after queueing swapin of the swap
+ * entries found in neighbouring ptes, within @vma and the same page table.
+ * Falls back to swapin_readahead() when VMA readahead is disabled.
+ *
+ * Caller must hold down_read on the vma->vm_mm.
+ */
+struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			pmd_t *pmd)
+{
+	unsigned long start, end, ra_addr;
+	unsigned int win, before, after;
+	struct page *page;
+	swp_entry_t entry;
+	pte_t *pte, ptent;
+	int dir;
+
+	if (!swap_vma_ra_enabled)
+		return swapin_readahead(fentry, gfp_mask, vma, addr);
+
+	addr &= PAGE_MASK;
+	win = swap_vma_ra_window(addr, &dir);
+	if (win == 1)
+		goto out;
+
+	if (dir > 0) {
+		before = 0;
+		after = win - 1;
+	} else if (dir < 0) {
+		before = win - 1;
+		after = 0;
+	} else {
+		before = (addr >> PAGE_SHIFT) & (win - 1);
+		after = win - 1 - before;
+	}
+
+	start = max(addr & PMD_MASK, vma->vm_start);
+	if ((addr - start) >> PAGE_SHIFT > before)
+		start = addr - before * PAGE_SIZE;
+	end = pmd_addr_end(addr, vma->vm_end);
+	if ((end - addr) >> PAGE_SHIFT > after + 1)
+		end = addr + (after + 1) * PAGE_SIZE;
+
+	for (ra_addr = start; ra_addr < end; ra_addr += PAGE_SIZE) {
+		if (ra_addr == addr)
+			continue;
+		/*
+		 * No pte lock: a racing change of the pte at worst reads in
+		 * a page we did not need, swapcache_prepare() catches swap
+		 * entries which have been freed.
+		 */
+		pte = pte_offset_map(pmd, ra_addr);
+		ptent = *pte;
+		pte_unmap(pte);
+		if (!is_swap_pte(ptent))
+			continue;
+		entry = pte_to_swp_entry(ptent);
+		if (unlikely(non_swap_entry(entry)))
+			continue;
+		page = __read_swap_cache_async(entry, gfp_mask, vma,
+					       ra_addr, 1);
+		if (!page)
+			break;
+		page_cache_release(page);
+	}
+	lru_add_drain();	/* Push any new pages onto the LRU now */
+out:
+	return read_swap_cache_async(fentry, gfp_mask, vma, addr);
+}
+
+#ifdef CONFIG_SYSFS
+/* see Documentation/ABI/testing/sysfs-kernel-mm-swap */
+
+static ssize_t vma_ra_enabled_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", swap_vma_ra_enabled);
+}
+
+static ssize_t vma_ra_enabled_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	unsigned long enabled;
+	int err;
+
+	err = strict_strtoul(buf, 10, &enabled);
+	if (err || enabled > 1)
+		return -EINVAL;
+
+	swap_vma_ra_enabled = enabled;
+
+	return count;
+}
+static struct kobj_attribute vma_ra_enabled_attr =
+	__ATTR(vma_ra_enabled, 0644, vma_ra_enabled_show,
+	       vma_ra_enabled_store);
+
+static ssize_t vma_ra_max_order_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", swap_vma_ra_max_order);
+}
+
+static ssize_t vma_ra_max_order_store(struct kobject *kobj,
+				      struct kobj_attribute *attr,
+				      const char *buf, size_t count)
+{
+	unsigned long order;
+	int err;
+
+	err = strict_strtoul(buf, 10, &order);
+	if (err || order > SWAP_VMA_RA_ORDER_MAX)
+		return -EINVAL;
+
+	swap_vma_ra_max_order = order;
+
+	return count;
+}
+static struct kobj_attribute vma_ra_max_order_attr =
+	__ATTR(vma_ra_max_order, 0644, vma_ra_max_order_show,
+	       vma_ra_max_order_store);
+
+static struct attribute *swap_attrs[] = {
+	&vma_ra_enabled_attr.attr,
+	&vma_ra_max_order_attr.attr,
+	NULL,
+};
+
+static struct attribute_group swap_attr_group = {
+	.attrs = swap_attrs,
+};
+
+static int __init swap_init_sysfs(void)
+{
+	struct kobject *swap_kobj;
+	int err;
+
+	swap_kobj = kobject_create_and_add("swap", mm_kobj);
+	if (unlikely(!swap_kobj)) {
+		printk(KERN_ERR "swap: failed kobject create\n");
+		return -ENOMEM;
+	}
+
+	err = sysfs_create_group(swap_kobj, &swap_attr_group);
+	if (err) {
+		printk(KERN_ERR "swap: failed register swap group\n");
+		kobject_put(swap_kobj);
+	}
+	return err;
+}
+subsys_initcall(swap_init_sysfs);
+#endif /* CONFIG_SYSFS */
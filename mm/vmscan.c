@@ -43,6 +43,7 @@
 #include <linux/sysctl.h>
 #include <linux/oom.h>
 #include <linux/prefetch.h>
+#include <linux/lru_gen.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -687,11 +688,49 @@ enum page_references {
 	PAGEREF_ACTIVATE,
 };
 
+/*
+ * With the multi-generational LRU, the age of a mapped page comes from
+ * the last page table walk instead of an rmap walk here: pages used
+ * since that walk are treated like referenced ones, pages idle for a
+ * single pass get another trip around the list, older ones go.
+ */
+static enum page_references page_check_generation(struct page *page,
+						  int age,
+						  struct scan_control *sc)
+{
+	int referenced_page = TestClearPageReferenced(page);
+
+	/* Lumpy reclaim - ignore references */
+	if (sc->reclaim_mode & RECLAIM_MODE_LUMPYRECLAIM)
+		return PAGEREF_RECLAIM;
+
+	if (age == 0) {
+		if (PageSwapBacked(page) || referenced_page)
+			return PAGEREF_ACTIVATE;
+		SetPageReferenced(page);
+		return PAGEREF_KEEP;
+	}
+
+	if (age == 1)
+		return PAGEREF_KEEP;
+
+	/* Reclaim if clean, defer dirty pages to writeback */
+	if (referenced_page && !PageSwapBacked(page))
+		return PAGEREF_RECLAIM_CLEAN;
+
+	return PAGEREF_RECLAIM;
+}
+
 static enum page_references page_check_references(struct page *page,
 						  struct scan_control *sc)
 {
 	int referenced_ptes, referenced_page;
 	unsigned long vm_flags;
+	int age;
+
+	age = scanning_global_lru(sc) ? lru_gen_page_age(page) : -1;
+	if (age >= 0)
+		return page_check_generation(page, age, sc);
 
 	referenced_ptes = page_referenced(page, 1, sc->mem_cgroup, &vm_flags);
 	referenced_page = TestClearPageReferenced(page);
@@ -1638,6 +1677,7 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 	struct zone_reclaim_stat *reclaim_stat = get_reclaim_stat(zone, sc);
 	unsigned long nr_rotated = 0;
 	isolate_mode_t reclaim_mode = ISOLATE_ACTIVE;
+	int age, referenced;
 
 	lru_add_drain();
 
@@ -1684,7 +1724,15 @@ static void shrink_active_list(unsigned long nr_pages, struct zone *zone,
 			continue;
 		}
 
-		if (page_referenced(page, 0, sc->mem_cgroup, &vm_flags)) {
+		age = scanning_global_lru(sc) ? lru_gen_page_age(page) : -1;
+		if (age >= 0) {
+			referenced = (age == 0);
+			vm_flags = 0;
+		} else {
+			referenced = page_referenced(page, 0, sc->mem_cgroup,
+						     &vm_flags);
+		}
+		if (referenced) {
 			nr_rotated += hpage_nr_pages(page);
 			/*
 			 * Identify referenced, file-backed active pages and
@@ -2263,6 +2311,12 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 		sc->nr_scanned = 0;
 		if (!priority)
 			disable_swap_token(sc->mem_cgroup);
+		/*
+		 * The page table walk may drop the last reference to an
+		 * mm, which can get into the filesystem.
+		 */
+		if (scanning_global_lru(sc) && (sc->gfp_mask & __GFP_FS))
+			lru_gen_maybe_age(priority < DEF_PRIORITY - 2);
 		aborted_reclaim = shrink_zones(priority, zonelist, sc);
 
 		/*
@@ -2595,6 +2649,8 @@ loop_again:
 		if (!priority)
 			disable_swap_token(NULL);
 
+		lru_gen_maybe_age(priority < DEF_PRIORITY - 2);
+
 		all_zones_ok = 1;
 		balanced = 0;
 
@@ -133,6 +133,7 @@
 #include <linux/pci.h>
 #include <linux/inetdevice.h>
 #include <linux/cpu_rmap.h>
+#include <net/busy_poll.h>
 
 #include "net-sysfs.h"
 
@@ -3508,6 +3509,7 @@ EXPORT_SYMBOL(skb_gro_reset_offset);
 
 gro_result_t napi_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 {
+	skb_mark_napi_id(skb, napi);
 	skb_gro_reset_offset(skb);
 
 	return napi_skb_finish(__napi_gro_receive(napi, skb), skb);
@@ -3610,6 +3612,7 @@ gro_result_t napi_gro_frags(struct napi_struct *napi)
 	if (!skb)
 		return GRO_DROP;
 
+	skb_mark_napi_id(skb, napi);
 	return napi_frags_finish(napi, skb, __napi_gro_receive(napi, skb));
 }
 EXPORT_SYMBOL(napi_gro_frags);
@@ -3744,6 +3747,142 @@ void napi_complete(struct napi_struct *n)
 }
 EXPORT_SYMBOL(napi_complete);
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+#define NAPI_HASH_BITS		8
+#define BUSY_POLL_BUDGET	8
+
+static DEFINE_SPINLOCK(napi_hash_lock);
+static unsigned int napi_gen_id;
+static struct hlist_head napi_hash[1 << NAPI_HASH_BITS];
+
+/* must be called under rcu_read_lock(), as we dont take a reference */
+static struct napi_struct *napi_by_id(unsigned int napi_id)
+{
+	struct hlist_head *head = &napi_hash[hash_32(napi_id, NAPI_HASH_BITS)];
+	struct hlist_node *node;
+	struct napi_struct *napi;
+
+	hlist_for_each_entry_rcu(napi, node, head, napi_hash_node)
+		if (napi->napi_id == napi_id)
+			return napi;
+
+	return NULL;
+}
+
+static void napi_hash_add(struct napi_struct *napi)
+{
+	if (test_and_set_bit(NAPI_STATE_HASHED, &napi->state))
+		return;
+
+	spin_lock(&napi_hash_lock);
+
+	/* 0 is not a valid id, and skip ids still in use after a wrap */
+	do {
+		if (unlikely(++napi_gen_id == 0))
+			napi_gen_id = 1;
+	} while (napi_by_id(napi_gen_id));
+	napi->napi_id = napi_gen_id;
+
+	hlist_add_head_rcu(&napi->napi_hash_node,
+			   &napi_hash[hash_32(napi->napi_id, NAPI_HASH_BITS)]);
+
+	spin_unlock(&napi_hash_lock);
+}
+
+static bool napi_hash_del(struct napi_struct *napi)
+{
+	if (!test_and_clear_bit(NAPI_STATE_HASHED, &napi->state))
+		return false;
+
+	spin_lock(&napi_hash_lock);
+	hlist_del_rcu(&napi->napi_hash_node);
+	spin_unlock(&napi_hash_lock);
+	return true;
+}
+
+static inline u64 busy_loop_us_clock(void)
+{
+	return local_clock() >> 10;
+}
+
+/**
+ *	sk_busy_loop - poll the NAPI context a socket receives from
+ *	@sk: socket with an empty receive queue
+ *	@nonblock: poll once instead of for up to sk->sk_ll_usec
+ *
+ *	Call the poll routine of the NAPI context the socket's last packet
+ *	arrived on, if it is not already scheduled or being polled
+ *	elsewhere, until data shows up on the receive queue, the busy
+ *	poll time runs out, or the task should give up the cpu.
+ *	Returns true if the receive queue is not empty.
+ */
+bool sk_busy_loop(struct sock *sk, int nonblock)
+{
+	u64 end_time = busy_loop_us_clock() + ACCESS_ONCE(sk->sk_ll_usec);
+	struct napi_struct *napi;
+	void *have;
+
+	rcu_read_lock();
+
+	napi = napi_by_id(sk->sk_napi_id);
+	if (!napi)
+		goto out;
+
+	do {
+		int work = 0;
+
+		local_bh_disable();
+		have = netpoll_poll_lock(napi);
+
+		/*
+		 * Owning NAPI_STATE_SCHED makes us the poller, as if
+		 * net_rx_action() had picked the instance off its list.
+		 * The instance is on no list, so give it a private one
+		 * for the driver's napi_complete() to take it off.
+		 */
+		if (napi_schedule_prep(napi)) {
+			INIT_LIST_HEAD(&napi->poll_list);
+			work = napi->poll(napi, BUSY_POLL_BUDGET);
+			trace_napi_poll(napi);
+
+			/*
+			 * Still ours (budget used up, or the driver did not
+			 * complete): hand the instance to net_rx_action().
+			 * Once completed the entry is poisoned or on some
+			 * cpu's poll list, so it cannot look empty.
+			 */
+			if (list_empty(&napi->poll_list))
+				__napi_schedule(napi);
+			if (work > 0)
+				NET_ADD_STATS_BH(sock_net(sk),
+						 LINUX_MIB_BUSYPOLLRXPACKETS,
+						 work);
+		}
+
+		netpoll_poll_unlock(have);
+		local_bh_enable();
+
+		if (nonblock || !skb_queue_empty(&sk->sk_receive_queue))
+			break;
+		cpu_relax();
+	} while (!need_resched() && !signal_pending(current) &&
+		 busy_loop_us_clock() < end_time);
+out:
+	rcu_read_unlock();
+	return !skb_queue_empty(&sk->sk_receive_queue);
+}
+EXPORT_SYMBOL(sk_busy_loop);
+#else
+static inline void napi_hash_add(struct napi_struct *napi)
+{
+}
+
+static inline bool napi_hash_del(struct napi_struct *napi)
+{
+	return false;
+}
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
 void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 		    int (*poll)(struct napi_struct *, int), int weight)
 {
@@ -3760,6 +3899,7 @@ void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 	napi->poll_owner = -1;
 #endif
 	set_bit(NAPI_STATE_SCHED, &napi->state);
+	napi_hash_add(napi);
 }
 EXPORT_SYMBOL(netif_napi_add);
 
@@ -3767,6 +3907,10 @@ void netif_napi_del(struct napi_struct *napi)
 {
 	struct sk_buff *skb, *next;
 
+	/* Let busy pollers that found it in napi_hash finish */
+	if (napi_hash_del(napi))
+		synchronize_net();
+
 	list_del_init(&napi->dev_list);
 	napi_free_frags(napi);
 
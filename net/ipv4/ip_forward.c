@@ -69,6 +69,10 @@ int ip_forward(struct sk_buff *skb)
 	if (skb->pkt_type != PACKET_HOST)
 		goto drop;
 
+	/* a socket found by early demux means this was never for forwarding */
+	if (unlikely(skb->sk))
+		goto drop;
+
 	skb_forward_csum(skb);
 
 	/*
@@ -314,11 +314,30 @@ drop:
 	return -1;
 }
 
+int sysctl_ip_early_demux __read_mostly = 1;
+
 static int ip_rcv_finish(struct sk_buff *skb)
 {
 	const struct iphdr *iph = ip_hdr(skb);
 	struct rtable *rt;
 
+	/*
+	 *	Let the transport protocol look up an established socket first;
+	 *	it may attach the input route cached on that socket and spare
+	 *	us the routing cache lookup below.
+	 */
+	if (sysctl_ip_early_demux && skb_dst(skb) == NULL && skb->sk == NULL &&
+	    !(iph->frag_off & htons(IP_MF | IP_OFFSET))) {
+		const struct net_protocol *ipprot;
+
+		ipprot = rcu_dereference(inet_protos[iph->protocol]);
+		if (ipprot && ipprot->early_demux) {
+			ipprot->early_demux(skb);
+			/* must reload iph, skb->head might have changed */
+			iph = ip_hdr(skb);
+		}
+	}
+
 	/*
 	 *	Initialise the virtual path cache for the packet. It describes
 	 *	how the packet travels inside Linux networking.
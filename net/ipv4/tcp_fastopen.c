@@ -0,0 +1,138 @@
+/*
+ * TCP Fast Open: data in SYN, authenticated by a cookie the server
+ * handed out on an earlier connection (draft-ietf-tcpm-fastopen).
+ *
+ * The server side cookie is a keyed hash of the client address; the
+ * client side keeps the cookies it received, together with the peer's
+ * MSS and a SYN loss history, in the inet_peer entry of the server.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/random.h>
+#include <linux/cryptohash.h>
+#include <linux/slab.h>
+#include <net/inetpeer.h>
+#include <net/tcp.h>
+
+int sysctl_tcp_fastopen __read_mostly;
+
+static u32 tcp_fastopen_secret[TCP_FASTOPEN_KEY_LENGTH / sizeof(u32)];
+static DEFINE_SEQLOCK(tcp_fastopen_secret_lock);
+
+/* Serializes updates of the client cookie cache in inet_peer */
+static DEFINE_SEQLOCK(tcp_fastopen_cache_lock);
+
+void tcp_fastopen_get_key(u32 *key)
+{
+	unsigned int seq;
+
+	do {
+		seq = read_seqbegin(&tcp_fastopen_secret_lock);
+		memcpy(key, tcp_fastopen_secret, sizeof(tcp_fastopen_secret));
+	} while (read_seqretry(&tcp_fastopen_secret_lock, seq));
+}
+
+void tcp_fastopen_set_key(const u32 *key)
+{
+	write_seqlock_bh(&tcp_fastopen_secret_lock);
+	memcpy(tcp_fastopen_secret, key, sizeof(tcp_fastopen_secret));
+	write_sequnlock_bh(&tcp_fastopen_secret_lock);
+}
+
+/* Computes the cookie a client at @addr has to present. */
+void tcp_fastopen_cookie_gen(__be32 addr, struct tcp_fastopen_cookie *foc)
+{
+	__u32 digest[SHA_DIGEST_WORDS];
+	__u32 workspace[SHA_WORKSPACE_WORDS];
+	__u32 mess[SHA_MESSAGE_BYTES / sizeof(__u32)];
+
+	memset(mess, 0, sizeof(mess));
+	mess[0] = (__force u32)addr;
+	tcp_fastopen_get_key(&mess[1]);
+
+	sha_init(digest);
+	sha_transform(digest, (char *)mess, workspace);
+
+	memcpy(foc->val, digest, TCP_FASTOPEN_COOKIE_SIZE);
+	foc->len = TCP_FASTOPEN_COOKIE_SIZE;
+}
+
+void tcp_fastopen_cache_get(struct sock *sk, u16 *mss,
+			    struct tcp_fastopen_cookie *cookie,
+			    int *syn_loss, unsigned long *last_syn_loss)
+{
+	struct inet_peer *peer;
+	bool release_it;
+	unsigned int seq;
+
+	peer = inet_csk(sk)->icsk_af_ops->get_peer(sk, &release_it);
+	if (!peer)
+		return;
+
+	do {
+		seq = read_seqbegin(&tcp_fastopen_cache_lock);
+		if (peer->tcp_fastopen_mss)
+			*mss = peer->tcp_fastopen_mss;
+		cookie->len = peer->tcp_fastopen_cookie_len;
+		memcpy(cookie->val, peer->tcp_fastopen_cookie,
+		       sizeof(peer->tcp_fastopen_cookie));
+		*syn_loss = peer->tcp_fastopen_syn_loss;
+		*last_syn_loss = *syn_loss ?
+				 peer->tcp_fastopen_last_syn_loss : 0;
+	} while (read_seqretry(&tcp_fastopen_cache_lock, seq));
+
+	if (release_it)
+		inet_putpeer(peer);
+}
+
+void tcp_fastopen_cache_set(struct sock *sk, u16 mss,
+			    struct tcp_fastopen_cookie *cookie, bool syn_lost)
+{
+	struct inet_peer *peer;
+	bool release_it;
+
+	peer = inet_csk(sk)->icsk_af_ops->get_peer(sk, &release_it);
+	if (!peer)
+		return;
+
+	write_seqlock_bh(&tcp_fastopen_cache_lock);
+	if (mss)
+		peer->tcp_fastopen_mss = mss;
+	if (cookie->len > 0) {
+		peer->tcp_fastopen_cookie_len = cookie->len;
+		memcpy(peer->tcp_fastopen_cookie, cookie->val, cookie->len);
+	}
+	if (syn_lost) {
+		++peer->tcp_fastopen_syn_loss;
+		peer->tcp_fastopen_last_syn_loss = jiffies;
+	} else
+		peer->tcp_fastopen_syn_loss = 0;
+	write_sequnlock_bh(&tcp_fastopen_cache_lock);
+
+	if (release_it)
+		inet_putpeer(peer);
+}
+
+void tcp_free_fastopen_req(struct tcp_sock *tp)
+{
+	if (tp->fastopen_req != NULL) {
+		kfree(tp->fastopen_req);
+		tp->fastopen_req = NULL;
+	}
+}
+
+static int __init tcp_fastopen_init(void)
+{
+	u32 key[TCP_FASTOPEN_KEY_LENGTH / sizeof(u32)];
+
+	BUILD_BUG_ON(sizeof(((struct inet_peer *)0)->tcp_fastopen_cookie) !=
+		     TCP_FASTOPEN_COOKIE_MAX);
+	BUILD_BUG_ON(TCP_FASTOPEN_KEY_LENGTH + sizeof(u32) >
+		     SHA_MESSAGE_BYTES);
+
+	get_random_bytes(key, sizeof(key));
+	tcp_fastopen_set_key(key);
+	return 0;
+}
+late_initcall(tcp_fastopen_init);
@@ -73,6 +73,7 @@
 #include <net/xfrm.h>
 #include <net/netdma.h>
 #include <net/secure_seq.h>
+#include <net/busy_poll.h>
 
 #include <linux/inet.h>
 #include <linux/ipv6.h>
@@ -773,7 +774,8 @@ static void tcp_v4_reqsk_send_ack(struct sock *sk, struct sk_buff *skb,
  */
 static int tcp_v4_send_synack(struct sock *sk, struct dst_entry *dst,
 			      struct request_sock *req,
-			      struct request_values *rvp)
+			      struct request_values *rvp,
+			      struct tcp_fastopen_cookie *foc)
 {
 	const struct inet_request_sock *ireq = inet_rsk(req);
 	struct flowi4 fl4;
@@ -784,7 +786,7 @@ static int tcp_v4_send_synack(struct sock *sk, struct dst_entry *dst,
 	if (!dst && (dst = inet_csk_route_req(sk, &fl4, req)) == NULL)
 		return -1;
 
-	skb = tcp_make_synack(sk, dst, req, rvp);
+	skb = tcp_make_synack(sk, dst, req, rvp, foc);
 
 	if (skb) {
 		__tcp_v4_send_check(skb, ireq->loc_addr, ireq->rmt_addr);
@@ -803,7 +805,7 @@ static int tcp_v4_rtx_synack(struct sock *sk, struct request_sock *req,
 			      struct request_values *rvp)
 {
 	TCP_INC_STATS_BH(sock_net(sk), TCP_MIB_RETRANSSEGS);
-	return tcp_v4_send_synack(sk, NULL, req, rvp);
+	return tcp_v4_send_synack(sk, NULL, req, rvp, NULL);
 }
 
 /*
@@ -1232,6 +1234,145 @@ static const struct tcp_request_sock_ops tcp_request_sock_ipv4_ops = {
 };
 #endif
 
+/* Decide whether the data carried by a SYN may be accepted right away.
+ * Returns true if so, with tcp_rsk(req)->rcv_nxt set to acknowledge the
+ * data. Otherwise @valid_foc is filled in with the cookie the client
+ * should use next time, when it asked for one or presented a bad one.
+ */
+static bool tcp_fastopen_check(struct sock *sk, struct sk_buff *skb,
+			       struct request_sock *req,
+			       struct tcp_fastopen_cookie *foc,
+			       struct tcp_fastopen_cookie *valid_foc)
+{
+	bool skip_cookie = false;
+
+	if (likely(foc->len < 0)) {
+		if ((sysctl_tcp_fastopen & TFO_SERVER_COOKIE_NOT_REQD) &&
+		    TCP_SKB_CB(skb)->end_seq != TCP_SKB_CB(skb)->seq + 1)
+			skip_cookie = true; /* no cookie to validate */
+		else
+			return false;
+	}
+
+	/* Make sure the listener has enabled fastopen and that we do not
+	 * exceed its accept backlog bound before spending cycles on the
+	 * cookie.
+	 */
+	if (!(sysctl_tcp_fastopen & TFO_SERVER_ENABLE) ||
+	    tcp_sk(sk)->fastopen_max_qlen == 0)
+		return false;
+
+	if (sk->sk_ack_backlog >= tcp_sk(sk)->fastopen_max_qlen) {
+		NET_INC_STATS_BH(sock_net(sk),
+				 LINUX_MIB_TCPFASTOPENLISTENOVERFLOW);
+		return false;
+	}
+
+	if (skip_cookie) {
+		tcp_rsk(req)->rcv_nxt = TCP_SKB_CB(skb)->end_seq;
+		return true;
+	}
+
+	tcp_fastopen_cookie_gen(ip_hdr(skb)->saddr, valid_foc);
+	if (foc->len == 0) {
+		/* Client requesting a cookie */
+		NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENCOOKIEREQD);
+		return false;
+	}
+	if (foc->len != TCP_FASTOPEN_COOKIE_SIZE ||
+	    memcmp(foc->val, valid_foc->val, TCP_FASTOPEN_COOKIE_SIZE)) {
+		/* Bad cookie: ignore the data and hand out a valid one */
+		NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENPASSIVEFAIL);
+		return false;
+	}
+	valid_foc->len = -1;
+
+	/* Acknowledge the data received from the peer. */
+	tcp_rsk(req)->rcv_nxt = TCP_SKB_CB(skb)->end_seq;
+	return true;
+}
+
+/* Fast Open: create the child socket straight from the SYN, queue the
+ * data it carries, and put the child into the accept queue in SYN_RECV
+ * state. The child keeps a private copy of the request so that it can
+ * retransmit the SYN-ACK itself until the handshake completes, see
+ * tcp_retransmit_timer(). Returns 0 on success, in which case @dst has
+ * been consumed; otherwise the caller falls back to a regular handshake.
+ */
+static int tcp_v4_conn_req_fastopen(struct sock *sk, struct sk_buff *skb,
+				    struct request_sock *req,
+				    struct dst_entry *dst,
+				    struct request_values *rvp)
+{
+	struct request_sock *rsk_copy;
+	struct tcp_sock *tp;
+	struct sock *child;
+
+	rsk_copy = inet_reqsk_alloc(&tcp_request_sock_ops);
+	if (rsk_copy == NULL)
+		goto fail;
+
+	child = inet_csk(sk)->icsk_af_ops->syn_recv_sock(sk, skb, req, NULL);
+	if (child == NULL) {
+		reqsk_free(rsk_copy);
+		goto fail;
+	}
+
+	/* syn_recv_sock() moved the IP options over to the child */
+	memcpy(rsk_copy, req, sizeof(struct tcp_request_sock));
+	rsk_copy->dl_next = NULL;
+	rsk_copy->sk = NULL;
+
+	tcp_v4_send_synack(sk, dst, req, rvp, NULL);
+
+	tp = tcp_sk(child);
+	tp->fastopen_rsk = rsk_copy;
+
+	/* RFC1323: The window in SYN & SYN/ACK segments is never
+	 * scaled. So correct it appropriately.
+	 */
+	tp->snd_wnd = ntohs(tcp_hdr(skb)->window);
+	tp->max_window = tp->snd_wnd;
+
+	/* Do what the final ACK of the handshake would otherwise do */
+	inet_csk(child)->icsk_af_ops->rebuild_header(child);
+	tcp_init_metrics(child);
+	tcp_init_congestion_control(child);
+	tcp_mtup_init(child);
+	tcp_init_buffer_space(child);
+
+	/* Queue the data carried in the SYN. The caller frees the skb,
+	 * so take a reference first.
+	 */
+	if (TCP_SKB_CB(skb)->end_seq != TCP_SKB_CB(skb)->seq + 1) {
+		skb = skb_get(skb);
+		skb_dst_drop(skb);
+		__skb_pull(skb, tcp_hdr(skb)->doff * 4);
+		skb_set_owner_r(skb, child);
+		__skb_queue_tail(&child->sk_receive_queue, skb);
+		tp->rcv_nxt = TCP_SKB_CB(skb)->end_seq;
+		tp->syn_data_acked = 1;
+	}
+
+	/* The request is not in the SYN table of the listener, so the
+	 * SYN-ACK is retransmitted off the child's own timer.
+	 */
+	inet_csk_reset_xmit_timer(child, ICSK_TIME_RETRANS,
+				  TCP_TIMEOUT_INIT, TCP_RTO_MAX);
+
+	inet_csk_reqsk_queue_add(sk, req, child);
+	sk->sk_data_ready(sk, 0);
+	bh_unlock_sock(child);
+	sock_put(child);
+
+	NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENPASSIVE);
+	return 0;
+
+fail:
+	NET_INC_STATS_BH(sock_net(sk), LINUX_MIB_TCPFASTOPENPASSIVEFAIL);
+	return -1;
+}
+
 int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 {
 	struct tcp_extend_values tmp_ext;
@@ -1244,6 +1385,8 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	__be32 saddr = ip_hdr(skb)->saddr;
 	__be32 daddr = ip_hdr(skb)->daddr;
 	__u32 isn = TCP_SKB_CB(skb)->when;
+	struct tcp_fastopen_cookie foc = { .len = -1 };
+	struct tcp_fastopen_cookie valid_foc = { .len = -1 };
 #ifdef CONFIG_SYN_COOKIES
 	int want_cookie = 0;
 #else
@@ -1288,7 +1431,8 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	tcp_clear_options(&tmp_opt);
 	tmp_opt.mss_clamp = TCP_MSS_DEFAULT;
 	tmp_opt.user_mss  = tp->rx_opt.user_mss;
-	tcp_parse_options(skb, &tmp_opt, &hash_location, 0);
+	tcp_parse_options(skb, &tmp_opt, &hash_location, 0,
+			  want_cookie ? NULL : &foc);
 
 	if (tmp_opt.cookie_plus > 0 &&
 	    tmp_opt.saw_tstamp &&
@@ -1395,8 +1539,18 @@ int tcp_v4_conn_request(struct sock *sk, struct sk_buff *skb)
 	}
 	tcp_rsk(req)->snt_isn = isn;
 
+	if (!want_cookie &&
+	    tcp_fastopen_check(sk, skb, req, &foc, &valid_foc)) {
+		if (tcp_v4_conn_req_fastopen(sk, skb, req, dst,
+				(struct request_values *)&tmp_ext) == 0)
+			return 0;
+		/* Fall back to a regular handshake, dropping the data */
+		tcp_rsk(req)->rcv_nxt = tcp_rsk(req)->rcv_isn + 1;
+	}
+
 	if (tcp_v4_send_synack(sk, dst, req,
-			       (struct request_values *)&tmp_ext) ||
+			       (struct request_values *)&tmp_ext,
+			       &valid_foc) ||
 	    want_cookie)
 		goto drop_and_free;
 
@@ -1562,6 +1716,44 @@ static __sum16 tcp_v4_checksum_init(struct sk_buff *skb)
 	return 0;
 }
 
+struct tcp_rx_dst_rcu {
+	struct rcu_head		rcu;
+	struct dst_entry	*dst;
+};
+
+static void tcp_rx_dst_free_rcu(struct rcu_head *head)
+{
+	struct tcp_rx_dst_rcu *r = container_of(head, struct tcp_rx_dst_rcu,
+						rcu);
+
+	dst_release(r->dst);
+	kfree(r);
+}
+
+/*
+ * Drop the input route cached on the socket.  tcp_v4_early_demux()
+ * reads sk_rx_dst without the socket lock, from softirq, so the
+ * reference is only released after an RCU-bh grace period.  Without
+ * memory for that the route is kept, but made unusable until the next
+ * packet tries again.
+ */
+void tcp_rx_dst_reset(struct sock *sk)
+{
+	struct tcp_rx_dst_rcu *r;
+
+	if (!sk->sk_rx_dst)
+		return;
+
+	r = kmalloc(sizeof(*r), GFP_ATOMIC);
+	if (!r) {
+		inet_sk(sk)->rx_dst_ifindex = 0;
+		return;
+	}
+	r->dst = sk->sk_rx_dst;
+	sk->sk_rx_dst = NULL;
+	call_rcu_bh(&r->rcu, tcp_rx_dst_free_rcu);
+}
+EXPORT_SYMBOL(tcp_rx_dst_reset);
 
 /* The socket must have it's spinlock held when we get
  * here.
@@ -1586,7 +1778,21 @@ int tcp_v4_do_rcv(struct sock *sk, struct sk_buff *skb)
 #endif
 
 	if (sk->sk_state == TCP_ESTABLISHED) { /* Fast path */
+		struct dst_entry *dst = sk->sk_rx_dst;
+
 		sock_rps_save_rxhash(sk, skb->rxhash);
+		sk_mark_napi_id(sk, skb);
+		if (dst) {
+			if (inet_sk(sk)->rx_dst_ifindex != skb->skb_iif ||
+			    dst->ops->check(dst, 0) == NULL)
+				tcp_rx_dst_reset(sk);
+		}
+		dst = skb_dst(skb);
+		if (unlikely(sk->sk_rx_dst == NULL) && dst &&
+		    !(dst->flags & DST_NOCACHE)) {
+			sk->sk_rx_dst = dst_clone(dst);
+			inet_sk(sk)->rx_dst_ifindex = skb->skb_iif;
+		}
 		if (tcp_rcv_established(sk, skb, tcp_hdr(skb), skb->len)) {
 			rsk = sk;
 			goto reset;
@@ -1604,14 +1810,17 @@ int tcp_v4_do_rcv(struct sock *sk, struct sk_buff *skb)
 
 		if (nsk != sk) {
 			sock_rps_save_rxhash(nsk, skb->rxhash);
+			sk_mark_napi_id(nsk, skb);
 			if (tcp_child_process(sk, nsk, skb)) {
 				rsk = nsk;
 				goto reset;
 			}
 			return 0;
 		}
-	} else
+	} else {
 		sock_rps_save_rxhash(sk, skb->rxhash);
+		sk_mark_napi_id(sk, skb);
+	}
 
 	if (tcp_rcv_state_process(sk, skb, tcp_hdr(skb), skb->len)) {
 		rsk = sk;
@@ -1636,6 +1845,55 @@ csum_err:
 }
 EXPORT_SYMBOL(tcp_v4_do_rcv);
 
+/*
+ *	Look up an established socket before the input route is resolved.
+ *	On a hit the socket reference is handed to tcp_v4_rcv() through
+ *	skb->sk, and the input route cached on the socket, if still valid,
+ *	is attached so that ip_rcv_finish() can skip the route lookup.
+ */
+void tcp_v4_early_demux(struct sk_buff *skb)
+{
+	struct net *net = dev_net(skb->dev);
+	const struct iphdr *iph;
+	const struct tcphdr *th;
+	struct dst_entry *dst;
+	struct sock *sk;
+
+	if (skb->pkt_type != PACKET_HOST)
+		return;
+
+	if (!pskb_may_pull(skb, ip_hdrlen(skb) + sizeof(struct tcphdr)))
+		return;
+
+	iph = ip_hdr(skb);
+	th = (struct tcphdr *)((char *)iph + ip_hdrlen(skb));
+
+	if (th->doff < sizeof(struct tcphdr) / 4)
+		return;
+
+	sk = __inet_lookup_established(net, &tcp_hashinfo,
+				       iph->saddr, th->source,
+				       iph->daddr, ntohs(th->dest),
+				       skb->skb_iif);
+	if (!sk)
+		return;
+
+	if (sk->sk_state == TCP_TIME_WAIT) {
+		/* Leave timewait sockets to the regular lookup */
+		inet_twsk_put(inet_twsk(sk));
+		return;
+	}
+
+	skb->sk = sk;
+	skb->destructor = sock_edemux;
+
+	dst = ACCESS_ONCE(sk->sk_rx_dst);
+	if (dst)
+		dst = dst_check(dst, 0);
+	if (dst && inet_sk(sk)->rx_dst_ifindex == skb->skb_iif)
+		skb_dst_set_noref(skb, dst);
+}
+
 /*
  *	From tcp_input.c
  */
@@ -1764,6 +2022,7 @@ do_time_wait:
 	case TCP_TW_SYN: {
 		struct sock *sk2 = inet_lookup_listener(dev_net(skb->dev),
 							&tcp_hashinfo,
+							iph->saddr, th->source,
 							iph->daddr, th->dest,
 							inet_iif(skb));
 		if (sk2) {
@@ -1950,6 +2209,15 @@ void tcp_v4_destroy_sock(struct sock *sk)
 	if (inet_csk(sk)->icsk_bind_hash)
 		inet_put_port(sk);
 
+	/* Release the private request sock of a Fast Open child that
+	 * never completed its handshake.
+	 */
+	if (tp->fastopen_rsk) {
+		reqsk_free(tp->fastopen_rsk);
+		tp->fastopen_rsk = NULL;
+	}
+	tcp_free_fastopen_req(tp);
+
 	/*
 	 * If sendmsg cached page exists, toss it.
 	 */
@@ -0,0 +1,156 @@
+/*
+ * futex-hash.c
+ *
+ * hash: Contention on the futex hash bucket locks
+ *
+ * Each thread keeps calling FUTEX_WAIT on its own futexes with a value
+ * that never matches, so every call only looks up and locks the hash
+ * bucket and returns straight away.  Threads of one process never touch
+ * the same futex; any contention comes from the hash itself.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static int	nr_threads	= 4;
+static int	nr_futexes	= 1024;
+static int	runtime		= 5;
+static bool	fshared;
+
+static const struct option options[] = {
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of threads"),
+	OPT_INTEGER('f', "futexes", &nr_futexes,
+		    "Specify number of futexes per thread"),
+	OPT_INTEGER('r', "runtime", &runtime,
+		    "Specify runtime in seconds"),
+	OPT_BOOLEAN('s', "shared", &fshared,
+		    "Use shared futexes instead of private ones"),
+	OPT_END()
+};
+
+static const char * const bench_futex_hash_usage[] = {
+	"perf bench futex hash <options>",
+	NULL
+};
+
+struct worker {
+	pthread_t thread;
+	unsigned int *futexes;
+	unsigned long ops;
+};
+
+static volatile int done;
+static int futex_op;
+
+static void *worker_thread(void *arg)
+{
+	struct worker *w = arg;
+	unsigned long ops = 0;
+	int i;
+
+	while (!done) {
+		for (i = 0; i < nr_futexes; i++) {
+			/* the futex is 0, so this fails with EAGAIN */
+			if (syscall(SYS_futex, &w->futexes[i], futex_op, 1,
+				    NULL, NULL, 0) == 0 ||
+			    (errno != EAGAIN && errno != EWOULDBLOCK))
+				die("futex() failed: %s\n", strerror(errno));
+		}
+		ops += nr_futexes;
+	}
+
+	w->ops = ops;
+	return NULL;
+}
+
+int bench_futex_hash(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	struct worker *workers;
+	struct timeval start, stop, diff;
+	unsigned long long total = 0, result_usec;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_futex_hash_usage, 0);
+
+	if (nr_threads <= 0 || nr_futexes <= 0 || runtime <= 0) {
+		fprintf(stderr, "Invalid thread, futex or runtime count\n");
+		return 1;
+	}
+
+	futex_op = FUTEX_WAIT;
+	if (!fshared)
+		futex_op |= FUTEX_PRIVATE_FLAG;
+
+	workers = calloc(nr_threads, sizeof(*workers));
+	if (!workers)
+		die("calloc() failed\n");
+
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].futexes = calloc(nr_futexes, sizeof(unsigned int));
+		if (!workers[i].futexes)
+			die("calloc() failed\n");
+	}
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_create(&workers[i].thread, NULL, worker_thread,
+				   &workers[i]))
+			die("pthread_create() failed\n");
+
+	sleep(runtime);
+	done = 1;
+
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		total += workers[i].ops;
+		free(workers[i].futexes);
+	}
+	free(workers);
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads, %d %s futexes each\n\n",
+		       nr_threads, nr_futexes, fshared ? "shared" : "private");
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14llu operations\n", total);
+		printf(" %14llu ops/sec\n",
+		       total * 1000000ULL / (result_usec ?: 1));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu\n", total * 1000000ULL / (result_usec ?: 1));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * mem-fault.c
+ *
+ * fault: Page fault scalability of a multithreaded process
+ *
+ * Each thread repeatedly faults in its own private anonymous region and
+ * throws the pages away again with MADV_DONTNEED.  Optionally another
+ * thread keeps mapping and unmapping a small region at the same time, so
+ * that the faulting threads compete with a holder of mmap_sem for write.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+static const char	*length_str	= "4MB";
+static int		nr_threads	= 4;
+static int		loops		= 100;
+static bool		mmap_thread;
+
+static const struct option options[] = {
+	OPT_STRING('l', "length", &length_str, "4MB",
+		    "Specify length of the region each thread faults in. "
+		    "available unit: B, MB, GB (upper and lower)"),
+	OPT_INTEGER('t', "threads", &nr_threads,
+		    "Specify number of faulting threads"),
+	OPT_INTEGER('r', "repeat", &loops,
+		    "Specify number of times each region is faulted in"),
+	OPT_BOOLEAN('m', "mmap", &mmap_thread,
+		    "Run a thread doing mmap()/munmap() alongside"),
+	OPT_END()
+};
+
+static const char * const bench_mem_fault_usage[] = {
+	"perf bench mem fault <options>",
+	NULL
+};
+
+static size_t len;
+static long page_size;
+static volatile int done;
+static unsigned long nr_mmaps;
+
+static void *fault_thread(void *arg __used)
+{
+	char *region;
+	size_t off;
+	int i;
+
+	region = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (region == MAP_FAILED)
+		die("mmap() failed: %s\n", strerror(errno));
+
+	for (i = 0; i < loops; i++) {
+		for (off = 0; off < len; off += page_size)
+			region[off] = 1;
+		if (madvise(region, len, MADV_DONTNEED))
+			die("madvise() failed: %s\n", strerror(errno));
+	}
+
+	munmap(region, len);
+	return NULL;
+}
+
+static void *mmap_loop_thread(void *arg __used)
+{
+	void *p;
+
+	while (!done) {
+		p = mmap(NULL, 16 * page_size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+			die("mmap() failed: %s\n", strerror(errno));
+		munmap(p, 16 * page_size);
+		nr_mmaps++;
+	}
+	return NULL;
+}
+
+int bench_mem_fault(int argc, const char **argv,
+		    const char *prefix __used)
+{
+	pthread_t *threads, mmapper;
+	struct timeval start, stop, diff;
+	unsigned long long result_usec, nr_faults;
+	s64 length;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_mem_fault_usage, 0);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	length = perf_atoll((char *)length_str);
+	if (length <= 0 || nr_threads <= 0 || loops <= 0) {
+		fprintf(stderr, "Invalid length, thread count or repeat count\n");
+		return 1;
+	}
+	len = ((size_t)length + page_size - 1) & ~(page_size - 1);
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		die("calloc() failed\n");
+
+	if (mmap_thread &&
+	    pthread_create(&mmapper, NULL, mmap_loop_thread, NULL))
+		die("pthread_create() failed\n");
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_create(&threads[i], NULL, fault_thread, NULL))
+			die("pthread_create() failed\n");
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	done = 1;
+	if (mmap_thread)
+		pthread_join(mmapper, NULL);
+	free(threads);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+	nr_faults = (unsigned long long)nr_threads * loops * (len / page_size);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d threads faulting %s, %d times each%s\n\n",
+		       nr_threads, length_str, loops,
+		       mmap_thread ? ", against mmap()/munmap()" : "");
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf usecs/fault\n",
+		       (double)result_usec / (double)nr_faults);
+		printf(" %14llu faults/sec\n",
+		       nr_faults * 1000000ULL / (result_usec ?: 1));
+		if (mmap_thread)
+			printf(" %14lu mmap()+munmap() pairs\n", nr_mmaps);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
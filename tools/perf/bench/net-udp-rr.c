@@ -0,0 +1,280 @@
+/*
+ * net-udp-rr.c
+ *
+ * udp-rr: UDP request/response latency
+ *
+ * A client sends a datagram and blocks in recv() until the echo comes
+ * back, over and over, and keeps a histogram of the round trip times.
+ * Without a host the echo server is a thread in this process on the
+ * loopback device; for a real NIC run "perf bench net udp-rr -S" on the
+ * other machine.  --busy-poll sets SO_BUSY_POLL on the sockets so that
+ * the receives poll the device instead of waiting for its interrupt.
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL	46
+#endif
+
+#define NR_BUCKETS	24	/* [2^b, 2^(b+1)) usecs, the last open ended */
+
+static const char	*host;
+static int		port		= 12865;
+static int		nr_requests	= 100000;
+static int		size		= 64;
+static int		busy_poll;
+static bool		server_only;
+
+static const struct option options[] = {
+	OPT_STRING('H', "host", &host, "host",
+		    "Send to a remote 'perf bench net udp-rr -S' instead of "
+		    "a local echo thread"),
+	OPT_INTEGER('p', "port", &port,
+		    "Specify UDP port of the echo server"),
+	OPT_INTEGER('n', "requests", &nr_requests,
+		    "Specify number of requests"),
+	OPT_INTEGER('s', "size", &size,
+		    "Specify datagram size in bytes"),
+	OPT_INTEGER('b', "busy-poll", &busy_poll,
+		    "Busy poll for up to this many usecs in recv() (SO_BUSY_POLL)"),
+	OPT_BOOLEAN('S', "server", &server_only,
+		    "Only run the echo server"),
+	OPT_END()
+};
+
+static const char * const bench_net_udp_rr_usage[] = {
+	"perf bench net udp-rr <options>",
+	NULL
+};
+
+static unsigned long histogram[NR_BUCKETS];
+
+static void set_busy_poll(int fd)
+{
+	if (busy_poll &&
+	    setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL,
+		       &busy_poll, sizeof(busy_poll)))
+		die("setsockopt(SO_BUSY_POLL) failed: %s\n", strerror(errno));
+}
+
+static int bind_server(void)
+{
+	struct sockaddr_in sin;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		die("socket() failed: %s\n", strerror(errno));
+	set_busy_poll(fd);
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	sin.sin_addr.s_addr = htonl(server_only ? INADDR_ANY : INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)))
+		die("bind() failed: %s\n", strerror(errno));
+
+	return fd;
+}
+
+static void *echo_server(void *arg)
+{
+	int fd = (long)arg;
+	struct sockaddr_in peer;
+	socklen_t peerlen = sizeof(peer);
+	char *buf;
+	ssize_t len;
+
+	buf = malloc(65536);
+	if (!buf)
+		die("malloc() failed\n");
+
+	/*
+	 * Echo from a socket connected to the first client, so that the
+	 * receive side can find the NAPI context to busy poll.
+	 */
+	len = recvfrom(fd, buf, 65536, 0, (struct sockaddr *)&peer, &peerlen);
+	if (len < 0)
+		die("recvfrom() failed: %s\n", strerror(errno));
+	if (connect(fd, (struct sockaddr *)&peer, peerlen))
+		die("connect() failed: %s\n", strerror(errno));
+
+	do {
+		if (send(fd, buf, len, 0) != len)
+			die("send() failed: %s\n", strerror(errno));
+		len = recv(fd, buf, 65536, 0);
+	} while (len >= 0);
+
+	die("recv() failed: %s\n", strerror(errno));
+	return NULL;
+}
+
+static int connect_client(void)
+{
+	struct addrinfo hints, *ai;
+	char portstr[16];
+	int fd, err;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	snprintf(portstr, sizeof(portstr), "%d", port);
+
+	err = getaddrinfo(host ?: "127.0.0.1", portstr, &hints, &ai);
+	if (err)
+		die("getaddrinfo() failed: %s\n", gai_strerror(err));
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		die("socket() failed: %s\n", strerror(errno));
+	set_busy_poll(fd);
+	if (connect(fd, ai->ai_addr, ai->ai_addrlen))
+		die("connect() failed: %s\n", strerror(errno));
+
+	freeaddrinfo(ai);
+	return fd;
+}
+
+static int usec_bucket(unsigned long usec)
+{
+	int b = 0;
+
+	while (usec > 1 && b < NR_BUCKETS - 1) {
+		usec >>= 1;
+		b++;
+	}
+	return b;
+}
+
+/* upper bound, in usecs, of the bucket the given fraction falls into */
+static unsigned long percentile(double frac)
+{
+	unsigned long seen = 0, want = frac * nr_requests;
+	int b;
+
+	for (b = 0; b < NR_BUCKETS; b++) {
+		seen += histogram[b];
+		if (seen >= want)
+			break;
+	}
+	return (1UL << (b + 1)) - 1;
+}
+
+int bench_net_udp_rr(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	struct timeval start, stop, diff, t0, t1;
+	unsigned long long total_usec = 0, result_usec;
+	unsigned long usec, min_usec = ~0UL, max_usec = 0;
+	pthread_t server;
+	char *buf;
+	int fd, i, b;
+
+	argc = parse_options(argc, argv, options,
+			     bench_net_udp_rr_usage, 0);
+
+	if (nr_requests <= 0 || size <= 0 || size > 65507 || busy_poll < 0) {
+		fprintf(stderr, "Invalid request count, size or busy poll time\n");
+		return 1;
+	}
+
+	if (server_only) {
+		echo_server((void *)(long)bind_server());
+		return 0;
+	}
+
+	if (!host &&
+	    pthread_create(&server, NULL, echo_server,
+			   (void *)(long)bind_server()))
+		die("pthread_create() failed\n");
+
+	fd = connect_client();
+
+	buf = calloc(1, size);
+	if (!buf)
+		die("calloc() failed\n");
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < nr_requests; i++) {
+		gettimeofday(&t0, NULL);
+		if (send(fd, buf, size, 0) != size)
+			die("send() failed: %s\n", strerror(errno));
+		if (recv(fd, buf, size, 0) != size)
+			die("recv() failed: %s\n", strerror(errno));
+		gettimeofday(&t1, NULL);
+
+		timersub(&t1, &t0, &diff);
+		usec = diff.tv_sec * 1000000UL + diff.tv_usec;
+		histogram[usec_bucket(usec)]++;
+		total_usec += usec;
+		if (usec < min_usec)
+			min_usec = usec;
+		if (usec > max_usec)
+			max_usec = usec;
+	}
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+	free(buf);
+	close(fd);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %d requests of %d bytes to %s:%d, busy poll %d usecs\n\n",
+		       nr_requests, size, host ?: "127.0.0.1", port, busy_poll);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf usecs/request (min %lu, max %lu)\n",
+		       (double)total_usec / nr_requests, min_usec, max_usec);
+		printf(" %14llu requests/sec\n",
+		       nr_requests * 1000000ULL / (result_usec ?: 1));
+		printf(" %14lu usecs 50th percentile (bucket bound)\n",
+		       percentile(0.5));
+		printf(" %14lu usecs 99th percentile (bucket bound)\n\n",
+		       percentile(0.99));
+
+		printf(" %14s  %s\n", "usecs", "requests");
+		for (b = 0; b < NR_BUCKETS; b++) {
+			if (!histogram[b])
+				continue;
+			printf(" %6lu - %-6lu  %lu\n",
+			       b ? 1UL << b : 0, (1UL << (b + 1)) - 1,
+			       histogram[b]);
+		}
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", (double)total_usec / nr_requests);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}